@@ -0,0 +1,77 @@
+#pragma once
+
+#include "Imgui/imgui.h"
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <cmath>
+
+//Debug fly camera, controlled through ImGui sliders
+class Camera {
+public:
+	Camera(uint32_t width, uint32_t height) :
+		mAspect(width / (float)height),
+		mHeight((float)height) {
+		//No widgets here, the first Update() of the frame would create them a second time
+		updateMatrices();
+	}
+
+	/* Shows the camera controls and recomputes the matrices, call once per frame inside an ImGui frame */
+	void Update() {
+		ImGui::SliderFloat3("Camera Position", &mPosition.x, -10, 10);
+		ImGui::SliderFloat2("Camera Rotation", mRotation, -3.14f, 3.14f);
+		updateMatrices();
+	}
+
+	const glm::mat4& GetView() const {
+		return mView;
+	}
+	const glm::mat4& GetProj() const {
+		return mProj;
+	}
+	const glm::vec3& GetPosition() const {
+		return mPosition;
+	}
+	/* World space planes as (normal, distance) with normals pointing inwards, order is left, right, bottom, top, near, far */
+	void GetFrustumPlanes(glm::vec4 outPlanes[6]) const {
+		glm::mat4 m = glm::transpose(mProj * mView);
+		outPlanes[0] = m[3] + m[0];
+		outPlanes[1] = m[3] - m[0];
+		outPlanes[2] = m[3] + m[1];
+		outPlanes[3] = m[3] - m[1];
+		outPlanes[4] = m[2]; //clip space depth is [0, 1]
+		outPlanes[5] = m[3] - m[2];
+		for (int i = 0; i < 6; i++) outPlanes[i] /= glm::length(glm::vec3(outPlanes[i]));
+	}
+	/* Pixels covered by one world unit at distance one, turns world space errors into screen space errors */
+	float GetProjectionScale() const {
+		return mHeight / (2.0f * std::tan(FOV_Y * 0.5f));
+	}
+
+private:
+	const float FOV_Y = glm::radians(45.0f);
+	const float NEAR_PLANE = 0.01f;
+	const float FAR_PLANE = 100.0f;
+	const glm::vec4 VIEW_DIR = glm::vec4(0.0f, -1.0f, -2.0f, 0.0f);
+
+	void updateMatrices() {
+		glm::vec4 d = glm::rotate(glm::mat4(1.0f), -mRotation[0], glm::vec3(0.0f, 1.0f, 0.0f)) * VIEW_DIR;
+		d = glm::rotate(glm::mat4(1.0f), mRotation[1], glm::vec3(1.0f, 0.0f, 0.0f)) * d;
+
+		mView = glm::lookAt(mPosition, mPosition + (glm::vec3)d, glm::vec3(0.0f, 1.0f, 0.0f));
+		mProj = glm::perspective(FOV_Y, mAspect, NEAR_PLANE, FAR_PLANE);
+		mProj[1][1] *= -1;
+	}
+
+private:
+	glm::vec3 mPosition = glm::vec3(0.0f, 1.0f, 3.0f);
+	float mRotation[2] = { 0.0f, 0.0f };
+	float mAspect;
+	float mHeight;
+
+	glm::mat4 mView;
+	glm::mat4 mProj;
+};
@@ -0,0 +1,101 @@
+#include "CookedTexture.h"
+
+#include "PixelConvert.h"
+
+#include "STBI/stb_image.h"
+
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+CookedTexture::CookedTexture(const std::string& sourceFile, const std::string& cookedFile, Content content) {
+	if (mFile.Open(cookedFile) && load(sourceFile, content)) return;
+
+	mFile.Close();
+	mLevels.clear();
+	cook(sourceFile, cookedFile, content);
+}
+
+uint64_t CookedTexture::GetDataSize() const {
+	uint64_t size = 0;
+	for (const Level& level : mLevels) size += level.size;
+	return size;
+}
+
+bool CookedTexture::load(const std::string& sourceFile, Content content) {
+	const uint8_t* data = mFile.GetData();
+	size_t size = mFile.GetSize();
+
+	if (size < sizeof(FileHeader)) return false;
+	const FileHeader* header = (const FileHeader*)data;
+	if (header->magic != MAGIC || header->version != VERSION || header->format > (uint32_t)TextureCompressor::BlockFormat::BC7) return false;
+	if (header->levelCount == 0 || header->content != (uint32_t)content) return false;
+	if (!FileUtils::matchesStamp(sourceFile, header->sourceSize, header->sourceWriteTime, header->sourceHash)) return false;
+
+	size_t tableEnd = sizeof(FileHeader) + sizeof(TextureCompressor::MipLevel) * (size_t)header->levelCount;
+	if (size < tableEnd) return false;
+	const TextureCompressor::MipLevel* records = (const TextureCompressor::MipLevel*)(data + sizeof(FileHeader));
+
+	mFormat = (TextureCompressor::BlockFormat)header->format;
+	mLevels.resize(header->levelCount);
+	for (uint32_t i = 0; i < header->levelCount; i++) {
+		const TextureCompressor::MipLevel& record = records[i];
+		if (record.size != TextureCompressor::getCompressedSize(mFormat, record.width, record.height)) return false;
+		if (tableEnd + record.offset + record.size > size) return false;
+
+		mLevels[i] = Level{ data + tableEnd + record.offset, record.size, record.width, record.height };
+	}
+	return true;
+}
+
+void CookedTexture::cook(const std::string& sourceFile, const std::string& cookedFile, Content content) {
+	int width;
+	int height;
+	int channels;
+	if (!stbi_info(sourceFile.c_str(), &width, &height, &channels)) throw std::runtime_error("Failed to load image " + sourceFile);
+
+	//Same as decoded images, RGB files are expanded with SIMD instead of by stb
+	int loadChannels = channels == STBI_rgb ? STBI_rgb : STBI_rgb_alpha;
+	stbi_uc* pixels = stbi_load(sourceFile.c_str(), &width, &height, &channels, loadChannels);
+	if (pixels == nullptr) throw std::runtime_error("Failed to load image " + sourceFile);
+
+	size_t pixelCount = (size_t)width * height;
+	uint8_t* rgba = pixels;
+	std::vector<uint8_t> expanded;
+	if (loadChannels == STBI_rgb) {
+		expanded.resize(pixelCount * 4);
+		PixelConvert::expandRGBToRGBA(pixels, expanded.data(), pixelCount);
+		stbi_image_free(pixels);
+		pixels = nullptr;
+		rgba = expanded.data();
+	}
+	//Before the mip chain, so transparent texels do not bleed their color into the coarser levels
+	if (content == Content::PremultipliedColor) PixelConvert::premultiplyAlphaSrgb(rgba, pixelCount);
+
+	//BC5 keeps red and green in two independent channels, the color formats would spend bits on blue and alpha
+	mFormat = content == Content::NormalMap ? TextureCompressor::BlockFormat::BC5 : TextureCompressor::chooseFormat(rgba, width, height);
+	std::vector<uint8_t> blocks;
+	std::vector<TextureCompressor::MipLevel> records;
+	TextureCompressor::compressMipChain(mFormat, rgba, width, height, blocks, records);
+	stbi_image_free(pixels);
+	expanded = std::vector<uint8_t>();
+
+	FileUtils::FileStamp stamp;
+	FileUtils::getFileStamp(sourceFile, stamp);
+	FileHeader header{ MAGIC, VERSION, (uint32_t)mFormat, (uint32_t)records.size(), stamp.size, stamp.writeTime, FileUtils::hashFile(sourceFile), (uint32_t)content, 0 };
+
+	//The file image doubles as the in memory copy, so the blocks are only held once
+	size_t tableEnd = sizeof(FileHeader) + sizeof(TextureCompressor::MipLevel) * records.size();
+	mCookedData.resize(tableEnd + blocks.size());
+	memcpy(mCookedData.data(), &header, sizeof(FileHeader));
+	memcpy(mCookedData.data() + sizeof(FileHeader), records.data(), sizeof(TextureCompressor::MipLevel) * records.size());
+	memcpy(mCookedData.data() + tableEnd, blocks.data(), blocks.size());
+
+	for (const TextureCompressor::MipLevel& record : records) {
+		mLevels.push_back(Level{ mCookedData.data() + tableEnd + record.offset, record.size, record.width, record.height });
+	}
+
+	if (!FileUtils::writeFileAtomic(cookedFile, mCookedData.data(), mCookedData.size())) {
+		std::cout << "Could not write cooked texture " << cookedFile << std::endl;
+	}
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "FileUtils.h"
+#include "TextureCompressor.h"
+
+#include <string>
+#include <vector>
+
+/*
+	Block compressed texture with its full mip chain, cooked once from a source image and cached on disk.
+	The cache file is a header, a table of mip levels and the blocks, bound to the source file like the
+	mesh cache. Loading a valid cache is a mmap, the blocks can be uploaded as they are.
+*/
+class CookedTexture {
+public:
+	/* How the source is prepared for compression, each kind is cached in its own file */
+	enum class Content : uint32_t {
+		Color,
+		PremultipliedColor, //sRGB color multiplied by alpha before the mip chain is built
+		NormalMap           //red and green only, always BC5
+	};
+
+	struct Level {
+		const uint8_t* data;
+		uint64_t size;
+		uint32_t width;
+		uint32_t height;
+	};
+
+public:
+	/*
+		Maps cookedFile if it still matches sourceFile, otherwise decodes, compresses and rewrites it.
+		content has to be the same for every load of one cookedFile, a cache of another content is recooked.
+	*/
+	CookedTexture(const std::string& sourceFile, const std::string& cookedFile, Content content);
+	CookedTexture(const CookedTexture&) = delete;
+	CookedTexture& operator=(const CookedTexture&) = delete;
+
+	TextureCompressor::BlockFormat GetFormat() const {
+		return mFormat;
+	}
+	uint32_t GetWidth() const {
+		return mLevels[0].width;
+	}
+	uint32_t GetHeight() const {
+		return mLevels[0].height;
+	}
+	/* Level data stays valid as long as the texture lives */
+	const std::vector<Level>& GetLevels() const {
+		return mLevels;
+	}
+	uint64_t GetDataSize() const;
+
+private:
+	static const uint32_t MAGIC = 0x5845544E; //"NTEX"
+	static const uint32_t VERSION = 4;
+
+	struct FileHeader {
+		uint32_t magic;
+		uint32_t version;
+		uint32_t format;
+		uint32_t levelCount;
+		uint64_t sourceSize;
+		int64_t sourceWriteTime;
+		uint64_t sourceHash;
+		uint32_t content;
+		uint32_t padding;
+	};
+
+private:
+	bool load(const std::string& sourceFile, Content content);
+	void cook(const std::string& sourceFile, const std::string& cookedFile, Content content);
+
+private:
+	FileUtils::MappedFile mFile;
+	std::vector<uint8_t> mCookedData; //only used when the texture was cooked right now
+	TextureCompressor::BlockFormat mFormat = TextureCompressor::BlockFormat::BC1;
+	std::vector<Level> mLevels;
+};
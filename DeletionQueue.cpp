@@ -0,0 +1,47 @@
+#include "DeletionQueue.h"
+
+#include <vector>
+
+DeletionQueue::DeletionQueue(uint32_t framesInFlight) :
+	mFramesInFlight(framesInFlight) {
+}
+
+DeletionQueue::~DeletionQueue() {
+	Flush();
+}
+
+void DeletionQueue::Push(std::function<void()> deleter) {
+	std::lock_guard<std::mutex> lock(mMutex);
+	mEntries.push_back(Entry{ mFrame, std::move(deleter) });
+}
+
+void DeletionQueue::BeginFrame(uint64_t frame) {
+	//Deleters run outside the lock, destroying one object may release others that push their own
+	std::vector<std::function<void()>> ready;
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mFrame = frame;
+		while (!mEntries.empty() && mEntries.front().frame + mFramesInFlight <= frame) {
+			ready.push_back(std::move(mEntries.front().deleter));
+			mEntries.pop_front();
+		}
+	}
+	for (std::function<void()>& deleter : ready) deleter();
+}
+
+void DeletionQueue::Flush() {
+	while (true) {
+		std::deque<Entry> entries;
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			if (mEntries.empty()) return;
+			entries.swap(mEntries);
+		}
+		for (Entry& entry : entries) entry.deleter();
+	}
+}
+
+size_t DeletionQueue::GetPendingCount() const {
+	std::lock_guard<std::mutex> lock(mMutex);
+	return mEntries.size();
+}
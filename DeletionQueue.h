@@ -0,0 +1,42 @@
+#pragma once
+
+#include <deque>
+#include <functional>
+#include <mutex>
+
+/*
+	Defers destroying GPU resources until no frame in flight can use them anymore, so releasing a resource
+	never has to drain the whole device. A deleter is tagged with the frame being recorded when it is pushed
+	and runs once the fence of that frame was waited, which also covers every frame submitted before it.
+	Thread safe, deleters run on the render thread and may push further deleters.
+*/
+class DeletionQueue {
+public:
+	DeletionQueue(uint32_t framesInFlight);
+	/* Runs whatever is left, the device has to be idle */
+	~DeletionQueue();
+	DeletionQueue(const DeletionQueue&) = delete;
+	DeletionQueue& operator=(const DeletionQueue&) = delete;
+
+	/* Deleter has to capture everything it needs by value, its owner is usually gone when it runs */
+	void Push(std::function<void()> deleter);
+	/* Render thread, once the fence for the new frame was waited. Runs the deleters of all finished frames */
+	void BeginFrame(uint64_t frame);
+	/* Runs every deleter right away, the device has to be idle */
+	void Flush();
+
+	size_t GetPendingCount() const;
+
+private:
+	struct Entry {
+		uint64_t frame;
+		std::function<void()> deleter;
+	};
+
+private:
+	const uint32_t mFramesInFlight;
+
+	mutable std::mutex mMutex;
+	std::deque<Entry> mEntries; //ordered by frame
+	uint64_t mFrame = 0;
+};
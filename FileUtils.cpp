@@ -0,0 +1,163 @@
+#include "FileUtils.h"
+
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace FileUtils {
+
+	bool getFileStamp(const std::string& filename, FileStamp& outStamp) {
+		std::error_code error;
+		std::filesystem::path path(filename);
+
+		uintmax_t size = std::filesystem::file_size(path, error);
+		if (error) return false;
+		auto writeTime = std::filesystem::last_write_time(path, error);
+		if (error) return false;
+
+		outStamp.size = size;
+		outStamp.writeTime = writeTime.time_since_epoch().count();
+		return true;
+	}
+
+	uint64_t hashFNV1a(const void* data, size_t size, uint64_t seed) {
+		const uint8_t* bytes = (const uint8_t*)data;
+		uint64_t hash = seed;
+		for (size_t i = 0; i < size; i++) {
+			hash ^= bytes[i];
+			hash *= 1099511628211ull;
+		}
+		return hash;
+	}
+
+	uint64_t hashFile(const std::string& filename) {
+		MappedFile file(filename);
+		if (!file.IsOpen()) return 0;
+		return hashFNV1a(file.GetData(), file.GetSize());
+	}
+
+	bool matchesStamp(const std::string& filename, uint64_t size, int64_t writeTime, uint64_t hash) {
+		FileStamp stamp;
+		if (!getFileStamp(filename, stamp) || stamp.size != size) return false;
+		if (stamp.writeTime == writeTime) return true;
+
+		//Touched but maybe not modified (e.g. fresh checkout), only the content decides
+		if (hashFile(filename) != hash) return false;
+		std::cout << "Timestamp of " << filename << " is outdated, but content hash matches" << std::endl;
+		return true;
+	}
+
+	bool writeFileAtomic(const std::string& filename, const void* data, size_t size) {
+		std::string tmpFile = filename + ".tmp";
+		{
+			std::ofstream file(tmpFile, std::ios::binary | std::ios::trunc);
+			if (!file) return false;
+			file.write((const char*)data, (std::streamsize)size);
+			if (!file) return false;
+		}
+
+		std::error_code error;
+		std::filesystem::rename(tmpFile, filename, error);
+		if (error) {
+			std::filesystem::remove(tmpFile, error);
+			return false;
+		}
+		return true;
+	}
+
+	MappedFile::MappedFile(const std::string& filename) {
+		Open(filename);
+	}
+
+	MappedFile::~MappedFile() {
+		Close();
+	}
+
+#ifdef _WIN32
+	bool MappedFile::Open(const std::string& filename) {
+		Close();
+
+		HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (file == INVALID_HANDLE_VALUE) return false;
+
+		LARGE_INTEGER fileSize;
+		if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+			CloseHandle(file);
+			return false;
+		}
+
+		HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (mapping == nullptr) {
+			CloseHandle(file);
+			return false;
+		}
+
+		void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		if (view == nullptr) {
+			CloseHandle(mapping);
+			CloseHandle(file);
+			return false;
+		}
+
+		mFileHandle = file;
+		mMappingHandle = mapping;
+		mData = (const uint8_t*)view;
+		mSize = (size_t)fileSize.QuadPart;
+		return true;
+	}
+
+	void MappedFile::Close() {
+		if (mData) UnmapViewOfFile(mData);
+		if (mMappingHandle) CloseHandle(mMappingHandle);
+		if (mFileHandle) CloseHandle(mFileHandle);
+		mData = nullptr;
+		mMappingHandle = nullptr;
+		mFileHandle = nullptr;
+		mSize = 0;
+	}
+#else
+	bool MappedFile::Open(const std::string& filename) {
+		Close();
+
+		int fd = open(filename.c_str(), O_RDONLY);
+		if (fd < 0) return false;
+
+		struct stat fileStat;
+		if (fstat(fd, &fileStat) != 0 || fileStat.st_size == 0) {
+			close(fd);
+			return false;
+		}
+
+		void* view = mmap(nullptr, (size_t)fileStat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (view == MAP_FAILED) {
+			close(fd);
+			return false;
+		}
+
+		mFileDescriptor = fd;
+		mData = (const uint8_t*)view;
+		mSize = (size_t)fileStat.st_size;
+		return true;
+	}
+
+	void MappedFile::Close() {
+		if (mData) munmap((void*)mData, mSize);
+		if (mFileDescriptor >= 0) close(mFileDescriptor);
+		mData = nullptr;
+		mFileDescriptor = -1;
+		mSize = 0;
+	}
+#endif
+
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+
+namespace FileUtils {
+
+	struct FileStamp {
+		uint64_t size = 0;
+		int64_t writeTime = 0;
+	};
+
+	bool getFileStamp(const std::string& filename, FileStamp& outStamp);
+	uint64_t hashFNV1a(const void* data, size_t size, uint64_t seed = 14695981039346656037ull);
+	uint64_t hashFile(const std::string& filename);
+	/* True if the file still has the recorded size and write time, or a touched file still has the recorded content hash */
+	bool matchesStamp(const std::string& filename, uint64_t size, int64_t writeTime, uint64_t hash);
+	/* Writes next to the target and renames, so an aborted write never leaves a broken file behind */
+	bool writeFileAtomic(const std::string& filename, const void* data, size_t size);
+
+	//Read-only memory mapping of a whole file, unmapped on destruction
+	class MappedFile {
+	public:
+		MappedFile() = default;
+		MappedFile(const std::string& filename);
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+		~MappedFile();
+
+		bool Open(const std::string& filename);
+		void Close();
+
+		bool IsOpen() const {
+			return mData != nullptr;
+		}
+		const uint8_t* GetData() const {
+			return mData;
+		}
+		size_t GetSize() const {
+			return mSize;
+		}
+
+	private:
+		const uint8_t* mData = nullptr;
+		size_t mSize = 0;
+#ifdef _WIN32
+		void* mFileHandle = nullptr;
+		void* mMappingHandle = nullptr;
+#else
+		int mFileDescriptor = -1;
+#endif
+	};
+
+}
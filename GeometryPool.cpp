@@ -0,0 +1,72 @@
+#include "GeometryPool.h"
+
+GeometryPool::GeometryPool(const GraphicsVulkan& gfx, uint32_t vertexStride, uint32_t vertexCapacity, vk::DeviceSize indexCapacity) :
+	mVertexStride(vertexStride),
+	mRanges(std::make_shared<Ranges>(vertexCapacity, (uint32_t)(indexCapacity / INDEX_UNIT_SIZE))) {
+	mGfx = &gfx;
+
+	gfx.GetAllocator().CreateBuffer((vk::DeviceSize)vertexStride * vertexCapacity, vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eTransferDst,
+		vk::MemoryPropertyFlagBits::eDeviceLocal, MemoryAllocator::Category::Mesh, mVertexBuffer, mVertexBufferMemory);
+	gfx.GetAllocator().CreateBuffer(indexCapacity, vk::BufferUsageFlagBits::eIndexBuffer | vk::BufferUsageFlagBits::eTransferDst,
+		vk::MemoryPropertyFlagBits::eDeviceLocal, MemoryAllocator::Category::Mesh, mIndexBuffer, mIndexBufferMemory);
+}
+
+GeometryPool::~GeometryPool() {
+	//The last frames may still draw from the buffers, they go once those are done
+	MemoryAllocator* allocator = &mGfx->GetAllocator();
+	vk::Buffer vertexBuffer = mVertexBuffer;
+	MemoryAllocator::Allocation vertexBufferMemory = mVertexBufferMemory;
+	vk::Buffer indexBuffer = mIndexBuffer;
+	MemoryAllocator::Allocation indexBufferMemory = mIndexBufferMemory;
+	mGfx->GetDeletionQueue().Push([=]() mutable {
+		allocator->DestroyBuffer(vertexBuffer, vertexBufferMemory);
+		allocator->DestroyBuffer(indexBuffer, indexBufferMemory);
+	});
+}
+
+GeometryPool::Allocation GeometryPool::Allocate(UploadBatcher& batcher, const void* vertices, uint32_t vertexCount, const void* indices, uint32_t indexCount, vk::IndexType indexType) {
+	uint32_t indexSize = indexType == vk::IndexType::eUint16 ? 2 : 4;
+
+	uint32_t vertexOffset;
+	uint32_t indexUnit;
+	{
+		std::lock_guard<std::mutex> lock(mRanges->mutex);
+		vertexOffset = mRanges->vertices.Allocate(vertexCount);
+		if (vertexOffset == RangeAllocator::INVALID_OFFSET) throw std::runtime_error("GeometryPool is out of vertex memory");
+		indexUnit = mRanges->indices.Allocate(getIndexUnits(indexCount, indexType));
+		if (indexUnit == RangeAllocator::INVALID_OFFSET) {
+			mRanges->vertices.Free(vertexOffset, vertexCount);
+			throw std::runtime_error("GeometryPool is out of index memory");
+		}
+	}
+
+	Allocation allocation;
+	allocation.vertexOffset = vertexOffset;
+	allocation.vertexCount = vertexCount;
+	allocation.firstIndex = indexUnit * INDEX_UNIT_SIZE / indexSize;
+	allocation.indexCount = indexCount;
+	allocation.indexType = indexType;
+
+	batcher.CopyToBuffer(vertices, (vk::DeviceSize)mVertexStride * vertexCount, mVertexBuffer, (vk::DeviceSize)mVertexStride * vertexOffset);
+	batcher.CopyToBuffer(indices, (vk::DeviceSize)indexSize * indexCount, mIndexBuffer, (vk::DeviceSize)indexUnit * INDEX_UNIT_SIZE);
+	return allocation;
+}
+
+void GeometryPool::Free(const Allocation& allocation) {
+	uint32_t indexSize = allocation.indexType == vk::IndexType::eUint16 ? 2 : 4;
+	uint32_t vertexOffset = allocation.vertexOffset;
+	uint32_t vertexCount = allocation.vertexCount;
+	uint32_t indexUnit = allocation.firstIndex * indexSize / INDEX_UNIT_SIZE;
+	uint32_t indexUnits = getIndexUnits(allocation.indexCount, allocation.indexType);
+	std::shared_ptr<Ranges> ranges = mRanges;
+	mGfx->GetDeletionQueue().Push([ranges, vertexOffset, vertexCount, indexUnit, indexUnits]() {
+		std::lock_guard<std::mutex> lock(ranges->mutex);
+		ranges->vertices.Free(vertexOffset, vertexCount);
+		ranges->indices.Free(indexUnit, indexUnits);
+	});
+}
+
+uint32_t GeometryPool::getIndexUnits(uint32_t indexCount, vk::IndexType indexType) const {
+	uint32_t indexSize = indexType == vk::IndexType::eUint16 ? 2 : 4;
+	return (indexCount * indexSize + INDEX_UNIT_SIZE - 1) / INDEX_UNIT_SIZE;
+}
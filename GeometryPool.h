@@ -0,0 +1,117 @@
+#pragma once
+
+#include "GraphicsVulkan.h"
+#include "UploadBatcher.h"
+
+#include <map>
+#include <memory>
+#include <mutex>
+
+//First fit allocator over an abstract range of units, neighbouring free ranges are merged on free
+class RangeAllocator {
+public:
+	static const uint32_t INVALID_OFFSET = UINT32_MAX;
+
+	RangeAllocator(uint32_t capacity) {
+		mFreeRanges[0] = capacity;
+	}
+
+	uint32_t Allocate(uint32_t size) {
+		for (auto it = mFreeRanges.begin(); it != mFreeRanges.end(); ++it) {
+			if (it->second < size) continue;
+
+			uint32_t offset = it->first;
+			uint32_t remaining = it->second - size;
+			mFreeRanges.erase(it);
+			if (remaining > 0) mFreeRanges[offset + size] = remaining;
+			return offset;
+		}
+		return INVALID_OFFSET;
+	}
+
+	void Free(uint32_t offset, uint32_t size) {
+		if (size == 0) return;
+
+		auto next = mFreeRanges.lower_bound(offset);
+		if (next != mFreeRanges.end() && offset + size == next->first) {
+			size += next->second;
+			next = mFreeRanges.erase(next);
+		}
+		if (next != mFreeRanges.begin()) {
+			auto prev = std::prev(next);
+			if (prev->first + prev->second == offset) {
+				prev->second += size;
+				return;
+			}
+		}
+		mFreeRanges[offset] = size;
+	}
+
+private:
+	std::map<uint32_t, uint32_t> mFreeRanges; //offset -> size
+};
+
+/*
+	One device local vertex buffer and one index buffer shared by all meshes of a scene.
+	Meshes only own ranges in them, so drawing needs a single bind and offsets in drawIndexed.
+	16 and 32 bit indices live in the same buffer, but need their own index buffer bind.
+	Allocate and Free are thread safe, the recorded uploads go through the caller's batcher.
+	The buffers and ranges still pending release are freed through the deletion queue, the pool itself can go any time.
+*/
+class GeometryPool {
+public:
+	struct Allocation {
+		uint32_t vertexOffset;
+		uint32_t vertexCount;
+		uint32_t firstIndex;
+		uint32_t indexCount;
+		vk::IndexType indexType;
+	};
+
+public:
+	GeometryPool(const GraphicsVulkan& gfx, uint32_t vertexStride, uint32_t vertexCapacity, vk::DeviceSize indexCapacity);
+	~GeometryPool();
+	GeometryPool(const GeometryPool&) = delete;
+	GeometryPool& operator=(const GeometryPool&) = delete;
+
+	/* Reserves space and records the upload, data can be reused after the call */
+	Allocation Allocate(UploadBatcher& batcher, const void* vertices, uint32_t vertexCount, const void* indices, uint32_t indexCount, vk::IndexType indexType);
+	/* The range is given back once no frame in flight can draw it anymore, even if the pool is destroyed before */
+	void Free(const Allocation& allocation);
+
+	void BindVertexBuffer(const vk::CommandBuffer& cmdBuffer) const {
+		cmdBuffer.bindVertexBuffers(0, mVertexBuffer, (uint64_t)0);
+	}
+	void BindIndexBuffer(const vk::CommandBuffer& cmdBuffer, vk::IndexType indexType) const {
+		cmdBuffer.bindIndexBuffer(mIndexBuffer, 0, indexType);
+	}
+
+private:
+	//Index ranges are handed out in 4 byte units, so 32 bit indices stay aligned
+	const uint32_t INDEX_UNIT_SIZE = 4;
+
+	//Shared with the pending frees, so they do not need the pool
+	struct Ranges {
+		std::mutex mutex;
+		RangeAllocator vertices;
+		RangeAllocator indices;
+
+		Ranges(uint32_t vertexCapacity, uint32_t indexUnitCapacity) :
+			vertices(vertexCapacity),
+			indices(indexUnitCapacity) {
+		}
+	};
+
+	uint32_t getIndexUnits(uint32_t indexCount, vk::IndexType indexType) const;
+
+private:
+	const GraphicsVulkan* mGfx;
+	uint32_t mVertexStride;
+
+	vk::Buffer mVertexBuffer;
+	MemoryAllocator::Allocation mVertexBufferMemory;
+	vk::Buffer mIndexBuffer;
+	MemoryAllocator::Allocation mIndexBufferMemory;
+
+	std::shared_ptr<Ranges> mRanges;
+};
@@ -2,12 +2,16 @@
 
 #include <vector>
 #include <iostream>
+#include <cstring>
 
 GraphicsVulkan::GraphicsVulkan(GLFWwindow* window) {
 	createInstance();
 	createSurface(window);
 	pickPhysicalDevice();
 	createDevice();
+	mAllocator = std::make_unique<MemoryAllocator>(mDevice, mPhysicalDevice, mMemoryBudget);
+	mStagingPool = std::make_unique<StagingPool>(mDevice, *mAllocator);
+	mDeletionQueue = std::make_unique<DeletionQueue>(MAX_FRAMES_IN_FLIGHT);
 	createSwapchain();
 	createCommandpool();
 	createCommandbuffers();
@@ -20,6 +24,9 @@ GraphicsVulkan::~GraphicsVulkan() {
 	mDevice.destroyCommandPool(mCommandPool);
 	for (auto imageView : mSwapchainImageViews) mDevice.destroyImageView(imageView);
 	mDevice.destroySwapchainKHR(mSwapchain);
+	mDeletionQueue.reset();
+	mStagingPool.reset();
+	mAllocator.reset();
 	mDevice.destroy();
 
 	mInstance.destroySurfaceKHR(mSurface);
@@ -29,6 +36,9 @@ GraphicsVulkan::~GraphicsVulkan() {
 void GraphicsVulkan::onFrameStart() {
 	mDevice.waitForFences(mFlightFence[currentFrame].get(), VK_TRUE, UINT64_MAX);
 	mDevice.resetFences(mFlightFence[currentFrame].get());
+	//The frame that used this fence before is done, and with it everything submitted earlier
+	mDeletionQueue->BeginFrame(mFrameNumber);
+	mStagingPool->Trim();
 	currentFbIndex = mDevice.acquireNextImageKHR(mSwapchain, UINT64_MAX, mImageAquiredSemaphores[currentFrame].get(), nullptr).value;
 	
 	mCommandBuffers[currentFbIndex].begin({ vk::CommandBufferUsageFlagBits::eOneTimeSubmit });
@@ -37,11 +47,13 @@ void GraphicsVulkan::onFrameStart() {
 void GraphicsVulkan::onFrameEnd() {
 	mCommandBuffers[currentFbIndex].end();
 
+	std::lock_guard<std::mutex> lock(mQueueMutex);
 	commitCommandBuffer(mCommandBuffers[currentFbIndex], mImageAquiredSemaphores[currentFrame].get(), mRenderFinishedSemaphores[currentFrame].get());
 	vk::PresentInfoKHR presentInfo{ 1, &mRenderFinishedSemaphores[currentFrame].get(), 1, &mSwapchain, &currentFbIndex };
 	mPresentQueue.presentKHR(presentInfo);
 
 	currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+	mFrameNumber++;
 }
 
 void GraphicsVulkan::commitCommandBuffer(const vk::CommandBuffer& cmdBuffer, const vk::Semaphore& submitWait, const vk::Semaphore& submitFinish) {
@@ -96,10 +108,45 @@ std::vector<vk::DeviceQueueCreateInfo> GraphicsVulkan::createQueueCreateInfos()
 
 void GraphicsVulkan::createDevice() {
 	std::vector<vk::DeviceQueueCreateInfo> queueInfos = createQueueCreateInfos();
+
+	if (mPhysicalDevice.getProperties().apiVersion < VK_API_VERSION_1_2) throw std::runtime_error("Device does not support Vulkan 1.2");
+	auto supportedChain = mPhysicalDevice.getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceVulkan12Features>();
+	const vk::PhysicalDeviceFeatures& supportedFeatures = supportedChain.get<vk::PhysicalDeviceFeatures2>().features;
+	const vk::PhysicalDeviceVulkan12Features& supportedFeatures12 = supportedChain.get<vk::PhysicalDeviceVulkan12Features>();
+
+	vk::PhysicalDeviceFeatures features{};
+	features.textureCompressionBC = supportedFeatures.textureCompressionBC;
+	mTextureCompressionBC = features.textureCompressionBC;
+	features.textureCompressionETC2 = supportedFeatures.textureCompressionETC2;
+	mTextureCompressionETC2 = features.textureCompressionETC2;
+	features.textureCompressionASTC_LDR = supportedFeatures.textureCompressionASTC_LDR;
+	mTextureCompressionASTC = features.textureCompressionASTC_LDR;
+	features.samplerAnisotropy = supportedFeatures.samplerAnisotropy;
+	mSamplerAnisotropy = features.samplerAnisotropy;
+	mMaxSamplerAnisotropy = mPhysicalDevice.getProperties().limits.maxSamplerAnisotropy;
+
+	//Material textures live in one partially bound, runtime sized sampler array, indexed by a push constant
+	if (!supportedFeatures12.runtimeDescriptorArray || !supportedFeatures12.descriptorBindingPartiallyBound || !supportedFeatures.shaderSampledImageArrayDynamicIndexing) {
+		throw std::runtime_error("Device does not support descriptor indexing");
+	}
+	features.shaderSampledImageArrayDynamicIndexing = VK_TRUE;
+	vk::PhysicalDeviceVulkan12Features features12{};
+	features12.runtimeDescriptorArray = VK_TRUE;
+	features12.descriptorBindingPartiallyBound = VK_TRUE;
+
+	//Lets the memory overlay show what the driver counts against each heap, including memory not made by the allocator
+	for (const vk::ExtensionProperties& extension : mPhysicalDevice.enumerateDeviceExtensionProperties()) {
+		if (std::strcmp(extension.extensionName, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME) == 0) mMemoryBudget = true;
+	}
+	if (mMemoryBudget) mDeviceExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+
+	vk::PhysicalDeviceFeatures2 features2{ features };
+	features2.pNext = &features12;
 	vk::DeviceCreateInfo deviceInfo{ {}, (uint32_t)queueInfos.size(), queueInfos.data(), 
 		(uint32_t) mDeviceLayers.size(), mDeviceLayers.data(),
 		(uint32_t) mDeviceExtensions.size(), mDeviceExtensions.data(),
 		nullptr };
+	deviceInfo.pNext = &features2;
 	mDevice = mPhysicalDevice.createDevice(deviceInfo);
 	mGfxQueue = mDevice.getQueue(mQueueFamilyIndices.graphicsFamily.value(), 0);
 	mPresentQueue = mDevice.getQueue(mQueueFamilyIndices.presentFamily.value(), 0);
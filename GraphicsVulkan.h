@@ -6,12 +6,23 @@
 #include "vulkan/vulkan.hpp"
 
 #include "VulkanUtils.h"
+#include "MemoryAllocator.h"
+#include "StagingPool.h"
+#include "DeletionQueue.h"
+
+#include <memory>
+#include <mutex>
 
 class GraphicsVulkan : public Graphics {
 	friend class Renderer;
 	friend class Material;
 	friend class Mesh;
 	friend class VulkanImage;
+	friend class UploadBatcher;
+	friend class GeometryPool;
+	friend class SamplerCache;
+	friend class UniformRing;
+	friend class SecondaryCommandPool;
 
 public:
 	GraphicsVulkan(GLFWwindow*);
@@ -30,6 +41,19 @@ public:
 		return currentFbIndex;
 	};
 
+	/* All buffers and images take their memory from here */
+	MemoryAllocator& GetAllocator() const {
+		return *mAllocator;
+	}
+	/* Staging memory shared by all upload batchers */
+	StagingPool& GetStagingPool() const {
+		return *mStagingPool;
+	}
+	/* Resources frames in flight may still use are destroyed through here instead of waiting for the device */
+	DeletionQueue& GetDeletionQueue() const {
+		return *mDeletionQueue;
+	}
+
 private:
 	//Vulkan
 	vk::Instance mInstance; //needs cleanup
@@ -39,6 +63,12 @@ private:
 	vk::Device mDevice; //needs cleanup
 	vk::Queue mGfxQueue;
 	vk::Queue mPresentQueue;
+	//Queues need external synchronization, loader threads submit uploads while frames are presented
+	mutable std::mutex mQueueMutex;
+
+	std::unique_ptr<MemoryAllocator> mAllocator; //needs cleanup, before the device
+	std::unique_ptr<StagingPool> mStagingPool; //needs cleanup, before the allocator
+	std::unique_ptr<DeletionQueue> mDeletionQueue; //needs cleanup, before everything its deleters use
 
 	//Swapchain
 	vk::SwapchainKHR mSwapchain; //needs cleanup
@@ -62,9 +92,18 @@ private:
 	std::vector<const char*> mDeviceLayers;
 	std::vector<const char*> mDeviceExtensions = { VK_KHR_SWAPCHAIN_EXTENSION_NAME };
 
+	//Optional features, enabled when the device supports them
+	bool mTextureCompressionBC = false;
+	bool mTextureCompressionETC2 = false;
+	bool mTextureCompressionASTC = false; //LDR only
+	bool mSamplerAnisotropy = false;
+	float mMaxSamplerAnisotropy = 1.0f;
+	bool mMemoryBudget = false;
+
 	//runtime variables
 	uint32_t currentFrame = 0;
 	uint32_t currentFbIndex = 0;
+	uint64_t mFrameNumber = 0; //frames submitted so far
 
 	//consts
 	int SURFACE_WIDTH;
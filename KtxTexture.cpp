@@ -0,0 +1,162 @@
+#include "KtxTexture.h"
+
+#include "STBI/stb_image.h"
+
+#include <algorithm>
+#include <cctype>
+#include <climits>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+	const uint8_t KTX2_IDENTIFIER[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+}
+
+KtxTexture::KtxTexture(const std::string& filename) {
+	if (!mFile.Open(filename)) throw std::runtime_error("Failed to open " + filename);
+	load(filename);
+}
+
+bool KtxTexture::IsKtxFile(const std::string& filename) {
+	const std::string extension = ".ktx2";
+	if (filename.size() < extension.size()) return false;
+	return std::equal(extension.begin(), extension.end(), filename.end() - extension.size(),
+		[](char a, char b) { return a == std::tolower((unsigned char)b); });
+}
+
+uint64_t KtxTexture::GetDataSize() const {
+	uint64_t size = 0;
+	for (const Level& level : mLevels) size += level.size;
+	return size;
+}
+
+void KtxTexture::load(const std::string& filename) {
+	const uint8_t* data = mFile.GetData();
+	size_t size = mFile.GetSize();
+
+	if (size < sizeof(FileHeader)) throw std::runtime_error(filename + " is too small for a KTX2 file");
+	const FileHeader* header = (const FileHeader*)data;
+	if (memcmp(header->identifier, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) != 0) throw std::runtime_error(filename + " is no KTX2 file");
+
+	//Payloads are copied as they are, zlib is the only supercompression stb_image can undo
+	bool inflate = header->supercompressionScheme == SUPERCOMPRESSION_ZLIB;
+	if (header->supercompressionScheme != SUPERCOMPRESSION_NONE && !inflate) {
+		throw std::runtime_error(filename + " uses supercompression scheme " + std::to_string(header->supercompressionScheme) + ", only uncompressed and zlib KTX2 files are supported");
+	}
+	mBlockDim = getBlockDim(header->vkFormat);
+	if (mBlockDim == 0) throw std::runtime_error(filename + " has unsupported VkFormat " + std::to_string(header->vkFormat));
+	if (header->pixelWidth == 0 || header->pixelHeight == 0 || header->pixelDepth > 1 || header->faceCount != 1) {
+		throw std::runtime_error(filename + " is no 2D texture, cube maps, 1D and 3D textures are not supported");
+	}
+
+	mVkFormat = header->vkFormat;
+	mLayerCount = std::max(header->layerCount, 1u);
+	//A level count of 0 asks the loader to generate the mips
+	mGenerateMips = header->levelCount == 0;
+	uint32_t levelCount = std::max(header->levelCount, 1u);
+
+	size_t indexEnd = sizeof(FileHeader) + sizeof(LevelIndex) * (size_t)levelCount;
+	if (size < indexEnd) throw std::runtime_error(filename + " has a truncated level index");
+	const LevelIndex* index = (const LevelIndex*)(data + sizeof(FileHeader));
+
+	//Levels are tightly packed blocks, their size follows from the format and the level dimensions alone
+	uint64_t blockSize = getBlockSize(mVkFormat);
+	auto getLevelSize = [&](uint32_t level) {
+		uint64_t blocksX = (std::max(header->pixelWidth >> level, 1u) + mBlockDim - 1) / mBlockDim;
+		uint64_t blocksY = (std::max(header->pixelHeight >> level, 1u) + mBlockDim - 1) / mBlockDim;
+		return blocksX * blocksY * blockSize * mLayerCount;
+	};
+
+	if (inflate) {
+		uint64_t inflatedSize = 0;
+		for (uint32_t i = 0; i < levelCount; i++) inflatedSize += getLevelSize(i);
+		mInflated.resize(inflatedSize);
+	}
+
+	mLevels.resize(levelCount);
+	uint64_t inflatedOffset = 0;
+	for (uint32_t i = 0; i < levelCount; i++) {
+		uint32_t width = std::max(header->pixelWidth >> i, 1u);
+		uint32_t height = std::max(header->pixelHeight >> i, 1u);
+		uint64_t expectedSize = getLevelSize(i);
+
+		const LevelIndex& level = index[i];
+		if (level.byteLength == 0 || level.byteOffset + level.byteLength > size) throw std::runtime_error(filename + " has an invalid mip level " + std::to_string(i));
+		//Uploads split the data into rows of blocks, a level of another size would be copied with the wrong pitch
+		uint64_t storedSize = inflate ? level.uncompressedByteLength : level.byteLength;
+		if (storedSize != expectedSize) {
+			throw std::runtime_error(filename + " has " + std::to_string(storedSize) + " bytes in mip level " + std::to_string(i) + ", its format and size need " + std::to_string(expectedSize));
+		}
+		const uint8_t* levelData = data + level.byteOffset;
+		uint64_t levelSize = level.byteLength;
+		if (inflate) {
+			//stb_image counts in int, every level has to inflate to exactly the size the index promises
+			uint8_t* target = mInflated.data() + inflatedOffset;
+			if (level.byteLength > INT_MAX || level.uncompressedByteLength > INT_MAX ||
+				stbi_zlib_decode_buffer((char*)target, (int)level.uncompressedByteLength, (const char*)levelData, (int)level.byteLength) != (int)level.uncompressedByteLength) {
+				throw std::runtime_error(filename + " has a corrupt zlib stream in mip level " + std::to_string(i));
+			}
+			levelData = target;
+			levelSize = level.uncompressedByteLength;
+			inflatedOffset += levelSize;
+		}
+
+		mLevels[i] = Level{ levelData, levelSize, width, height };
+	}
+}
+
+uint32_t KtxTexture::getBlockDim(uint32_t vkFormat) {
+	if (vkFormat >= 1 && vkFormat <= 123) return 1;     //Uncompressed color formats up to VK_FORMAT_E5B9G9R9_UFLOAT_PACK32
+	if (vkFormat >= 131 && vkFormat <= 156) return 4;   //BC1 to BC7, ETC2 and EAC
+	//ASTC, the UNORM and SRGB variant of every footprint are neighbours. Uploads step over width and height with
+	//the same block dimension, so the footprints that are wider than tall (5x4, 8x6, 12x10, ...) are rejected
+	switch (vkFormat) {
+	case 157: case 158: return 4;
+	case 161: case 162: return 5;
+	case 165: case 166: return 6;
+	case 171: case 172: return 8;
+	case 179: case 180: return 10;
+	case 183: case 184: return 12;
+	}
+	return 0;
+}
+
+uint32_t KtxTexture::getBlockSize(uint32_t vkFormat) {
+	//Uncompressed formats as runs of consecutive values that share a texel size, up to VK_FORMAT_E5B9G9R9_UFLOAT_PACK32
+	struct Run {
+		uint32_t last;
+		uint32_t size;
+	};
+	static const Run UNCOMPRESSED[] = {
+		{ 1, 1 },    //R4G4
+		{ 8, 2 },    //4 and 5 bit packed formats
+		{ 15, 1 },   //R8
+		{ 22, 2 },   //R8G8
+		{ 36, 3 },   //R8G8B8, B8G8R8
+		{ 69, 4 },   //8 bit RGBA orders, A2R10G10B10, A2B10G10R10
+		{ 76, 2 },   //R16
+		{ 83, 4 },   //R16G16
+		{ 90, 6 },   //R16G16B16
+		{ 97, 8 },   //R16G16B16A16
+		{ 100, 4 },  //R32
+		{ 103, 8 },  //R32G32
+		{ 106, 12 }, //R32G32B32
+		{ 109, 16 }, //R32G32B32A32
+		{ 112, 8 },  //R64
+		{ 115, 16 }, //R64G64
+		{ 118, 24 }, //R64G64B64
+		{ 121, 32 }, //R64G64B64A64
+		{ 123, 4 }   //B10G11R11, E5B9G9R9
+	};
+	if (vkFormat >= 1 && vkFormat <= 123) {
+		for (const Run& run : UNCOMPRESSED) {
+			if (vkFormat <= run.last) return run.size;
+		}
+	}
+	if (vkFormat >= 131 && vkFormat <= 134) return 8;   //BC1
+	if (vkFormat == 139 || vkFormat == 140) return 8;   //BC4
+	if (vkFormat >= 147 && vkFormat <= 150) return 8;   //ETC2 RGB and RGB A1
+	if (vkFormat == 153 || vkFormat == 154) return 8;   //EAC R11
+	if (vkFormat >= 131 && vkFormat <= 184) return 16;  //Other BC, ETC2 and EAC formats, every ASTC footprint
+	return 0;
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include "FileUtils.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*
+	Memory mapped KTX2 container. The level data is taken from the mapping as it is, so a texture
+	cooked offline goes from the page cache into staging memory with a single copy.
+	Zlib supercompressed files are inflated into memory once on load, other supercompression schemes are rejected.
+	Only 2D textures and 2D arrays are accepted, the format is a plain VkFormat.
+*/
+class KtxTexture {
+public:
+	/* Data of one mip level holds all array layers back to back */
+	struct Level {
+		const uint8_t* data;
+		uint64_t size;
+		uint32_t width;
+		uint32_t height;
+	};
+
+public:
+	/* Throws if the file can not be mapped or is no supported KTX2 file */
+	KtxTexture(const std::string& filename);
+	KtxTexture(const KtxTexture&) = delete;
+	KtxTexture& operator=(const KtxTexture&) = delete;
+
+	static bool IsKtxFile(const std::string& filename);
+
+	uint32_t GetVkFormat() const {
+		return mVkFormat;
+	}
+	uint32_t GetWidth() const {
+		return mLevels[0].width;
+	}
+	uint32_t GetHeight() const {
+		return mLevels[0].height;
+	}
+	uint32_t GetLayerCount() const {
+		return mLayerCount;
+	}
+	/* Texel dimension of a block, 1 for uncompressed formats */
+	uint32_t GetBlockDim() const {
+		return mBlockDim;
+	}
+	/* The file asks for mips to be generated at load time, only the base level is present then */
+	bool WantsGeneratedMips() const {
+		return mGenerateMips;
+	}
+	/* Level data stays valid as long as the texture lives */
+	const std::vector<Level>& GetLevels() const {
+		return mLevels;
+	}
+	uint64_t GetDataSize() const;
+
+private:
+	static const uint32_t SUPERCOMPRESSION_NONE = 0;
+	static const uint32_t SUPERCOMPRESSION_ZLIB = 3;
+
+	struct FileHeader {
+		uint8_t identifier[12];
+		uint32_t vkFormat;
+		uint32_t typeSize;
+		uint32_t pixelWidth;
+		uint32_t pixelHeight;
+		uint32_t pixelDepth;
+		uint32_t layerCount;
+		uint32_t faceCount;
+		uint32_t levelCount;
+		uint32_t supercompressionScheme;
+		uint32_t dfdByteOffset;
+		uint32_t dfdByteLength;
+		uint32_t kvdByteOffset;
+		uint32_t kvdByteLength;
+		uint64_t sgdByteOffset;
+		uint64_t sgdByteLength;
+	};
+	struct LevelIndex {
+		uint64_t byteOffset;
+		uint64_t byteLength;
+		uint64_t uncompressedByteLength;
+	};
+
+private:
+	void load(const std::string& filename);
+	/* Texel width and height of a block, 0 for formats the loader does not know how to copy */
+	static uint32_t getBlockDim(uint32_t vkFormat);
+	/* Bytes of one block, or of one texel for uncompressed formats. Only meaningful for formats getBlockDim accepts */
+	static uint32_t getBlockSize(uint32_t vkFormat);
+
+private:
+	FileUtils::MappedFile mFile;
+	std::vector<uint8_t> mInflated; //all levels of a zlib supercompressed file
+	uint32_t mVkFormat = 0;
+	uint32_t mLayerCount = 1;
+	uint32_t mBlockDim = 1;
+	bool mGenerateMips = false;
+	std::vector<Level> mLevels;
+};
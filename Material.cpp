@@ -2,76 +2,83 @@
 
 #include "Material.h"
 
-#include <chrono>
+#include "Mesh.h"
+
+#include <algorithm>
+#include <array>
 #include <math.h>
 
-Material::Material(const GraphicsVulkan& gfx, const Renderer& renderer) :
+Material::Material(const GraphicsVulkan& gfx, const Renderer& renderer, std::shared_ptr<VulkanImage> image) :
 	SURFACE_WIDTH(gfx.SURFACE_WIDTH),
-	SURFACE_HEIGHT(gfx.SURFACE_HEIGHT),
-	mImage(gfx, "textures/test.png"){
+	SURFACE_HEIGHT(gfx.SURFACE_HEIGHT){
 	mGfx = &gfx;
+	mDescriptorPool = renderer.mDescriptorPool;
+	vk::PhysicalDeviceLimits limits = gfx.mPhysicalDevice.getProperties().limits;
+	mTextureCapacity = std::min({ Renderer::MAX_TEXTURES, limits.maxPerStageDescriptorSamplers, limits.maxPerStageDescriptorSampledImages,
+		limits.maxDescriptorSetSamplers, limits.maxDescriptorSetSampledImages });
 	createStages(gfx.mDevice);
 	createDescriptorSetLayout(gfx.mDevice);
 	createPipeline(gfx.mDevice, renderer.GetRenderPass(), gfx.SURFACE_WIDTH, gfx.SURFACE_HEIGHT);
-	createUniformBuffer(gfx.mDevice, gfx.mPhysicalDevice, gfx.MAX_FRAMES_IN_FLIGHT);
-	createSampler(gfx.mDevice);
-	createDescriptorSet(gfx.mDevice, renderer.mDescriptorPool);
+	mUniformRing = &renderer.GetUniformRing();
+	mSampler = renderer.GetSamplerCache().GetTrilinear();
+	createDescriptorSets(gfx.mDevice);
+	AddImage(std::move(image));
 }
 
 Material::~Material() {
-	mGfx->mDevice.destroySampler(mSampler);
-	mGfx->mDevice.waitIdle();
-	mGfx->mDevice.destroyBuffer(mUniformStagingBuffer);
-	mGfx->mDevice.freeMemory(mUniformStagingBufferMemory);
-
-	mGfx->mDevice.destroyDescriptorSetLayout(mDescriptorSetLayout);
-	mGfx->mDevice.destroyPipelineLayout(mPipelineLayout);
-	mGfx->mDevice.destroyPipeline(mGfxPipeline);
+	//Images of the texture table are released with the members and defer themselves
+	vk::Device device = mGfx->mDevice;
+	vk::DescriptorSetLayout descriptorSetLayout = mDescriptorSetLayout;
+	vk::PipelineLayout pipelineLayout = mPipelineLayout;
+	vk::Pipeline pipeline = mGfxPipeline;
+	mGfx->GetDeletionQueue().Push([device, descriptorSetLayout, pipelineLayout, pipeline]() {
+		device.destroyPipeline(pipeline);
+		device.destroyPipelineLayout(pipelineLayout);
+		device.destroyDescriptorSetLayout(descriptorSetLayout);
+	});
 }
 void Material::cleanup(const GraphicsVulkan& gfx) {
 }
 
-void Material::UpdateUniforms(vk::Device device, vk::CommandBuffer buffer, uint32_t frameIndex) {
-	static auto startTime = std::chrono::high_resolution_clock::now();
-	auto currentTime = std::chrono::high_resolution_clock::now();
-	float deltaTime = std::chrono::duration<float, std::chrono::seconds::period>(currentTime - startTime).count();
-
-	Uniforms ubo;
-
-	ubo.model = glm::translate(glm::identity<glm::mat4>(), glm::vec3(0.1f * deltaTime, 0.0f, 0.0f));
-	ubo.model = glm::identity<glm::mat4>();
-	ubo.view = glm::identity<glm::mat4>();
-	ubo.proj = glm::identity<glm::mat4>();
-
-	static glm::vec3 camPos(0.0f, 1.0f, 3.0f);
-	static glm::vec4 viewDir(0.0f, -1.0f, -2.0f, 0.0f);
-
-	static float* rotations = new float[2]{ 0.0f, 0.0f};
-	ImGui::SliderFloat3("Camera Position", &camPos.x, -10, 10);
-	ImGui::SliderFloat2("Camera Rotation", rotations, -3.14f, 3.14f);
-
-	glm::vec4 d = glm::rotate(glm::mat4(1.0f), -rotations[0], glm::vec3(0.0f, 1.0f, 0.0f)) * viewDir;
-	d = glm::rotate(glm::mat4(1.0f), rotations[1], glm::vec3(1.0f, 0.0f, 0.0f)) * d;
+void Material::UpdateUniforms(vk::Device device, uint32_t frameIndex, const Camera& camera) {
+	mFrameIndex = frameIndex;
+	updateTextureTable(device, frameIndex);
+
+	//Coherent memory the vertex shader reads directly, no copy and no barrier needed
+	UniformRing::Slice slice = mUniformRing->Allocate(sizeof(Uniforms));
+	Uniforms* ubo = (Uniforms*)slice.data;
+	ubo->model = glm::identity<glm::mat4>();
+	ubo->view = camera.GetView();
+	ubo->proj = camera.GetProj();
+	mUniformOffset = slice.offset;
+}
 
-	//ubo.model = glm::rotate(glm::mat4(1.0f), deltaTime * glm::radians(45.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-	ubo.view = glm::lookAt(camPos, camPos + (glm::vec3)d, glm::vec3(0.0f, 1.0f, 0.0f));
-	ubo.proj = glm::perspective(glm::radians(45.0f), SURFACE_WIDTH / (float)SURFACE_HEIGHT, 0.01f, 100.0f);
-	ubo.proj[1][1] *= -1;
+void Material::Bind(const vk::CommandBuffer& cmdBuffer) {
+	cmdBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, mGfxPipeline);
+	cmdBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, mPipelineLayout, 0, mDescriptorSets[mFrameIndex], mUniformOffset);
+}
 
-	uint32_t srcOffset = sizeof(Uniforms) * frameIndex;
+uint32_t Material::AddImage(std::shared_ptr<VulkanImage> image) {
+	if (mTextures.size() >= mTextureCapacity) throw std::runtime_error("Texture table is full");
 
-	Uniforms* data = (Uniforms*)device.mapMemory(mUniformStagingBufferMemory, srcOffset, sizeof(Uniforms));
-	memcpy(data, &ubo, sizeof(Uniforms));
-	device.unmapMemory(mUniformStagingBufferMemory);
+	//Written into the sets when each frame is recorded next
+	TextureEntry entry;
+	entry.image = std::move(image);
+	entry.boundImages.resize(mDescriptorSets.size());
+	mTextures.push_back(std::move(entry));
+	return (uint32_t)mTextures.size() - 1;
+}
 
+void Material::SetImage(uint32_t index, std::shared_ptr<VulkanImage> image) {
+	mTextures[index].image = std::move(image);
+}
 
-	vk::BufferCopy region{ srcOffset, 0, sizeof(Uniforms) };
-	buffer.copyBuffer(mUniformStagingBuffer, mUniformBuffer, region);
+void Material::PushVertexDecode(const vk::CommandBuffer& cmdBuffer, const VertexFormat::Decode& decode) {
+	cmdBuffer.pushConstants(mPipelineLayout, vk::ShaderStageFlagBits::eVertex, 0, sizeof(VertexFormat::Decode), &decode);
 }
 
-void Material::Bind(const vk::CommandBuffer& cmdBuffer) {
-	cmdBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, mGfxPipeline);
-	cmdBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, mPipelineLayout, 0, mDescriptorSet, {});
+void Material::PushTextureIndex(const vk::CommandBuffer& cmdBuffer, uint32_t index) {
+	cmdBuffer.pushConstants(mPipelineLayout, vk::ShaderStageFlagBits::eFragment, TEXTURE_INDEX_OFFSET, sizeof(uint32_t), &index);
 }
 
 
@@ -92,19 +99,23 @@ void Material::createPipeline(vk::Device device, vk::RenderPass renderpass, uint
 	vk::PipelineColorBlendAttachmentState blendAttachmentState{ VK_FALSE, vk::BlendFactor::eOne, vk::BlendFactor::eZero,
 		vk::BlendOp::eAdd, vk::BlendFactor::eOne, vk::BlendFactor::eZero, vk::BlendOp::eAdd,
 		vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG | vk::ColorComponentFlagBits::eB | vk::ColorComponentFlagBits::eA };
-	vk::VertexInputBindingDescription vertBindings = Vertex::getBindingDesc();
-	std::vector<vk::VertexInputAttributeDescription> vertAttributes = Vertex::getAttrDesc();
+	vk::VertexInputBindingDescription vertBindings = VertexFormat::GpuVertex::getBindingDesc();
+	std::vector<vk::VertexInputAttributeDescription> vertAttributes = VertexFormat::GpuVertex::getAttrDesc();
 
 	vk::PipelineVertexInputStateCreateInfo vertexInputCreateInfo{ {}, 1, &vertBindings, (uint32_t)vertAttributes.size(), vertAttributes.data() };
 	vk::PipelineInputAssemblyStateCreateInfo assemblyCreateInfo{ {}, vk::PrimitiveTopology::eTriangleList, VK_FALSE };
 	vk::PipelineViewportStateCreateInfo viewportStateCreateInfo{ {}, 1, &viewport, 1, &scissor };
-	vk::PipelineRasterizationStateCreateInfo rasterCreateInfo{ {}, VK_FALSE, VK_FALSE, vk::PolygonMode::eFill, vk::CullModeFlagBits::eBack, vk::FrontFace::eClockwise, VK_FALSE, 0, 0, 0, 1.0f };
+	vk::PipelineRasterizationStateCreateInfo rasterCreateInfo{ {}, VK_FALSE, VK_FALSE, vk::PolygonMode::eFill, vk::CullModeFlagBits::eBack, Mesh::FRONT_FACE, VK_FALSE, 0, 0, 0, 1.0f };
 	vk::PipelineMultisampleStateCreateInfo multisampleCreateInfo{ {}, vk::SampleCountFlagBits::e1, VK_FALSE, 1.0f, nullptr, VK_FALSE, VK_FALSE };
 	vk::PipelineDepthStencilStateCreateInfo depthCreateInfo{ {}, VK_TRUE, VK_TRUE, vk::CompareOp::eLess, VK_FALSE, VK_FALSE, {}, {}, 0.0f, 1.0f };
 	vk::PipelineColorBlendStateCreateInfo blendStateCreateInfo{ {}, VK_FALSE, vk::LogicOp::eCopy, 1, &blendAttachmentState, std::array<float, 4>({ 0.0f, 0.0f, 0.0f, 0.0f }) };
 	vk::PipelineDynamicStateCreateInfo dynamicStateCreateInfo{ {}, 0, nullptr };
 
-	vk::PipelineLayoutCreateInfo layoutCreateInfo{ {}, 1, &mDescriptorSetLayout, 0, nullptr };
+	std::array<vk::PushConstantRange, 2> pushConstantRanges{
+		vk::PushConstantRange{ vk::ShaderStageFlagBits::eVertex, 0, sizeof(VertexFormat::Decode) },
+		vk::PushConstantRange{ vk::ShaderStageFlagBits::eFragment, TEXTURE_INDEX_OFFSET, sizeof(uint32_t) }
+	};
+	vk::PipelineLayoutCreateInfo layoutCreateInfo{ {}, 1, &mDescriptorSetLayout, (uint32_t)pushConstantRanges.size(), pushConstantRanges.data() };
 	mPipelineLayout = device.createPipelineLayout(layoutCreateInfo);
 
 	vk::GraphicsPipelineCreateInfo pipelineCreateInfo{ {}, (uint32_t)mStages.size(), mStages.data(), &vertexInputCreateInfo, &assemblyCreateInfo, nullptr, &viewportStateCreateInfo,
@@ -114,27 +125,46 @@ void Material::createPipeline(vk::Device device, vk::RenderPass renderpass, uint
 
 void Material::createDescriptorSetLayout(vk::Device device) {
 	std::vector<vk::DescriptorSetLayoutBinding> bindings{
-		vk::DescriptorSetLayoutBinding { 0, vk::DescriptorType::eUniformBuffer, 1, vk::ShaderStageFlagBits::eVertex, nullptr },
-		vk::DescriptorSetLayoutBinding { 1, vk::DescriptorType::eCombinedImageSampler, 1, vk::ShaderStageFlagBits::eFragment, nullptr }
+		vk::DescriptorSetLayoutBinding { 0, vk::DescriptorType::eUniformBufferDynamic, 1, vk::ShaderStageFlagBits::eVertex, nullptr },
+		vk::DescriptorSetLayoutBinding { 1, vk::DescriptorType::eCombinedImageSampler, mTextureCapacity, vk::ShaderStageFlagBits::eFragment, nullptr }
 	};
-	
+	//Table entries that were never written are fine as long as no draw indexes them
+	std::vector<vk::DescriptorBindingFlags> bindingFlags{ {}, vk::DescriptorBindingFlagBits::ePartiallyBound };
+	vk::DescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo{ (uint32_t)bindingFlags.size(), bindingFlags.data() };
+
 	vk::DescriptorSetLayoutCreateInfo layoutCreateInfo({}, (uint32_t)bindings.size(), bindings.data());
+	layoutCreateInfo.pNext = &bindingFlagsInfo;
 	mDescriptorSetLayout = device.createDescriptorSetLayout(layoutCreateInfo);
 }
-void Material::createUniformBuffer(vk::Device device, vk::PhysicalDevice physDevice, uint32_t maxInFlight) {
-	//Buffer alignement!!
-	VulkanUtils::createBuffer(device, physDevice, sizeof(Uniforms) * maxInFlight, vk::BufferUsageFlagBits::eTransferSrc, vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent, mUniformStagingBuffer, mUniformStagingBufferMemory);
-	VulkanUtils::createBuffer(device, physDevice, sizeof(Uniforms), vk::BufferUsageFlagBits::eUniformBuffer | vk::BufferUsageFlagBits::eTransferDst, vk::MemoryPropertyFlagBits::eDeviceLocal, mUniformBuffer, mUniformBufferMemory);
-}
-void Material::createDescriptorSet(vk::Device device, vk::DescriptorPool pool) {
-	vk::DescriptorSetAllocateInfo allocateInfo(pool, 1, &mDescriptorSetLayout);
-	mDescriptorSet = device.allocateDescriptorSets(allocateInfo)[0];
-
-	vk::DescriptorBufferInfo bufferInfo{ mUniformBuffer, 0, sizeof(Uniforms) };
-	vk::DescriptorImageInfo imageInfo{ mSampler, mImage.GetImageView(), vk::ImageLayout::eShaderReadOnlyOptimal };
-	std::vector<vk::WriteDescriptorSet> writes = {
-		vk::WriteDescriptorSet{ mDescriptorSet, 0, 0, 1, vk::DescriptorType::eUniformBuffer, nullptr, &bufferInfo, nullptr },
-		vk::WriteDescriptorSet{ mDescriptorSet, 1, 0, 1, vk::DescriptorType::eCombinedImageSampler, &imageInfo, nullptr, nullptr }
-	};
+void Material::createDescriptorSets(vk::Device device) {
+	std::vector<vk::DescriptorSetLayout> layouts(mGfx->MAX_FRAMES_IN_FLIGHT, mDescriptorSetLayout);
+	vk::DescriptorSetAllocateInfo allocateInfo(mDescriptorPool, (uint32_t)layouts.size(), layouts.data());
+	mDescriptorSets = device.allocateDescriptorSets(allocateInfo);
+
+	//Each frame's set points at the start of that frame's ring region, Bind() adds the slice offset
+	std::vector<vk::DescriptorBufferInfo> bufferInfos;
+	for (uint32_t i = 0; i < (uint32_t)mDescriptorSets.size(); i++) {
+		bufferInfos.push_back(vk::DescriptorBufferInfo{ mUniformRing->GetBuffer(i), 0, sizeof(Uniforms) });
+	}
+	std::vector<vk::WriteDescriptorSet> writes;
+	for (uint32_t i = 0; i < (uint32_t)mDescriptorSets.size(); i++) {
+		writes.push_back(vk::WriteDescriptorSet{ mDescriptorSets[i], 0, 0, 1, vk::DescriptorType::eUniformBufferDynamic, nullptr, &bufferInfos[i], nullptr });
+	}
 	device.updateDescriptorSets(writes, nullptr);
+}
+
+void Material::updateTextureTable(vk::Device device, uint32_t frameIndex) {
+	//Only entries whose image changed are written, infos are reserved so the writes can point into them
+	std::vector<vk::DescriptorImageInfo> imageInfos;
+	std::vector<vk::WriteDescriptorSet> writes;
+	imageInfos.reserve(mTextures.size());
+	for (uint32_t i = 0; i < (uint32_t)mTextures.size(); i++) {
+		TextureEntry& entry = mTextures[i];
+		if (entry.boundImages[frameIndex] == entry.image) continue;
+
+		imageInfos.push_back(vk::DescriptorImageInfo{ mSampler, entry.image->GetImageView(), vk::ImageLayout::eShaderReadOnlyOptimal });
+		writes.push_back(vk::WriteDescriptorSet{ mDescriptorSets[frameIndex], 1, i, 1, vk::DescriptorType::eCombinedImageSampler, &imageInfos.back(), nullptr, nullptr });
+		entry.boundImages[frameIndex] = entry.image;
+	}
+	if (!writes.empty()) device.updateDescriptorSets(writes, nullptr);
 }
\ No newline at end of file
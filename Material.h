@@ -3,13 +3,17 @@
 #include "GraphicsVulkan.h"
 #include "Renderer.h"
 #include "VulkanImage.h"
+#include "Camera.h"
 
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include "VertexFormat.h"
+
 #include <fstream>
+#include <memory>
 
 //VulkanMaterial
 class Material {
@@ -19,62 +23,61 @@ private:
 		glm::mat4 view;
 		glm::mat4 proj;
 	};
-	struct Vertex {
-		glm::vec3 pos;
-		glm::vec3 color;
-		glm::vec2 uv;
-
-		static vk::VertexInputBindingDescription getBindingDesc() {
-			vk::VertexInputBindingDescription desc(0, sizeof(Vertex), vk::VertexInputRate::eVertex);
-			return desc;
-		}
-
-		static std::vector<vk::VertexInputAttributeDescription> getAttrDesc() {
-			std::vector<vk::VertexInputAttributeDescription> desc = {
-				vk::VertexInputAttributeDescription(0, 0, vk::Format::eR32G32B32Sfloat, offsetof(Vertex, pos)),
-				vk::VertexInputAttributeDescription(1, 0, vk::Format::eR32G32B32Sfloat, offsetof(Vertex, color)),
-				vk::VertexInputAttributeDescription{ 2, 0, vk::Format::eR32G32Sfloat, offsetof(Vertex, uv) }
-			};
-			return desc;
-		}
-	};
 
 public:
-	Material(const GraphicsVulkan& gfx, const Renderer& renderer);
+	/* Images are shared, get them from a TextureCache */
+	Material(const GraphicsVulkan& gfx, const Renderer& renderer, std::shared_ptr<VulkanImage> image);
 	~Material();
 	Material(const Material&) = delete;
 	Material& operator= (const Material&) = delete;
 
 	void cleanup(const GraphicsVulkan& gfx);
-	void UpdateUniforms(vk::Device device, vk::CommandBuffer buffer, uint32_t frameIndex);
+	/*
+		Writes the uniforms into this frame's slice of the renderer's uniform ring, and the texture table
+		entries of this frame that changed since it was last recorded
+	*/
+	void UpdateUniforms(vk::Device device, uint32_t frameIndex, const Camera& camera);
+	/* Binds the pipeline and the texture table, once for all draws */
 	void Bind(const vk::CommandBuffer& cmdBuffer);
+	/* Adds an image to the texture table and returns its index for PushTextureIndex(). Index 0 is the constructor image */
+	uint32_t AddImage(std::shared_ptr<VulkanImage> image);
+	/* Replaces the image of a table entry, frames pick it up as soon as they are recorded again */
+	void SetImage(uint32_t index, std::shared_ptr<VulkanImage> image);
+	void PushVertexDecode(const vk::CommandBuffer& cmdBuffer, const VertexFormat::Decode& decode);
+	void PushTextureIndex(const vk::CommandBuffer& cmdBuffer, uint32_t index);
 
 private:
 	void createStages(vk::Device device);
 	void createPipeline(vk::Device device, vk::RenderPass renderpass, uint32_t width, uint32_t height);
 	void createDescriptorSetLayout(vk::Device device);
-	void createUniformBuffer(vk::Device device, vk::PhysicalDevice physDevice, uint32_t maxInFlight);
-	void createDescriptorSet(vk::Device device, vk::DescriptorPool pool);
-	void createSampler(vk::Device device) {
-		vk::SamplerCreateInfo createInfo{ {}, vk::Filter::eNearest, vk::Filter::eNearest, vk::SamplerMipmapMode::eNearest, vk::SamplerAddressMode::eRepeat, vk::SamplerAddressMode::eRepeat, vk::SamplerAddressMode::eRepeat, 0, VK_FALSE, 1, VK_FALSE, vk::CompareOp::eAlways, 0, 0, vk::BorderColor::eIntOpaqueBlack, VK_FALSE};
-		mSampler = device.createSampler(createInfo);
-	}
+	void createDescriptorSets(vk::Device device);
+	void updateTextureTable(vk::Device device, uint32_t frameIndex);
 
 private:
 	vk::DescriptorSetLayout mDescriptorSetLayout;
 	vk::PipelineLayout mPipelineLayout;
 	vk::Pipeline mGfxPipeline;
 	std::vector<vk::PipelineShaderStageCreateInfo> mStages;
-	vk::Buffer mUniformBuffer;
-	vk::DeviceMemory mUniformBufferMemory;
-	vk::DescriptorSet mDescriptorSet;
+	struct TextureEntry {
+		std::shared_ptr<VulkanImage> image;
+		//Image each frame's set points to, it stays alive as long as that frame may sample it
+		std::vector<std::shared_ptr<VulkanImage>> boundImages;
+	};
+	//Fragment stage part of the push constants, follows the vertex decode
+	static const uint32_t TEXTURE_INDEX_OFFSET = sizeof(VertexFormat::Decode);
+
+	vk::DescriptorPool mDescriptorPool;
+	//One set per frame in flight, so table entries are only rewritten once the frame using them finished
+	std::vector<vk::DescriptorSet> mDescriptorSets;
+	std::vector<TextureEntry> mTextures;
+	uint32_t mTextureCapacity;
+	uint32_t mFrameIndex = 0;
 
-	vk::Buffer mUniformStagingBuffer;
-	vk::DeviceMemory mUniformStagingBufferMemory;
+	UniformRing* mUniformRing; //owned by the renderer
+	uint32_t mUniformOffset = 0; //dynamic offset of the slice written this frame
 
-	vk::Sampler mSampler;
+	vk::Sampler mSampler; //owned by the renderer's sampler cache
 
-	VulkanImage mImage;
 	const GraphicsVulkan* mGfx;
 
 	const uint32_t SURFACE_WIDTH;
@@ -0,0 +1,441 @@
+#include "MemoryAllocator.h"
+
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace {
+	//Both expect a value that is not 0
+	uint32_t highestBit(uint64_t value) {
+#ifdef _MSC_VER
+		unsigned long index;
+		_BitScanReverse64(&index, value);
+		return (uint32_t)index;
+#else
+		return 63 - (uint32_t)__builtin_clzll(value);
+#endif
+	}
+	uint32_t lowestBit(uint32_t value) {
+#ifdef _MSC_VER
+		unsigned long index;
+		_BitScanForward(&index, value);
+		return (uint32_t)index;
+#else
+		return (uint32_t)__builtin_ctz(value);
+#endif
+	}
+	vk::DeviceSize alignUp(vk::DeviceSize value, vk::DeviceSize alignment) {
+		return (value + alignment - 1) / alignment * alignment;
+	}
+}
+
+MemoryAllocator::MemoryAllocator(vk::Device device, vk::PhysicalDevice physDevice, bool memoryBudget) {
+	mDevice = device;
+	mPhysicalDevice = physDevice;
+	mMemoryProperties = physDevice.getMemoryProperties();
+	mMemoryBudget = memoryBudget;
+
+	mHeapStats.resize(mMemoryProperties.memoryHeapCount);
+	for (uint32_t i = 0; i < mMemoryProperties.memoryHeapCount; i++) {
+		mHeapStats[i].heapSize = mMemoryProperties.memoryHeaps[i].size;
+		mHeapStats[i].deviceLocal = (bool)(mMemoryProperties.memoryHeaps[i].flags & vk::MemoryHeapFlagBits::eDeviceLocal);
+	}
+
+	//Defaults until the owner sets its own, textures may take half of the largest device local heap and meshes a quarter
+	vk::DeviceSize deviceLocalSize = 0;
+	for (const HeapStats& heap : mHeapStats) {
+		if (heap.deviceLocal) deviceLocalSize = std::max(deviceLocalSize, heap.heapSize);
+	}
+	mCategoryStats[(uint32_t)Category::Texture].budget = deviceLocalSize / 2;
+	mCategoryStats[(uint32_t)Category::Mesh].budget = deviceLocalSize / 4;
+
+	mHeaps.resize(mMemoryProperties.memoryTypeCount * 2);
+	for (uint32_t type = 0; type < mMemoryProperties.memoryTypeCount; type++) {
+		vk::DeviceSize heapSize = mMemoryProperties.memoryHeaps[mMemoryProperties.memoryTypes[type].heapIndex].size;
+		vk::DeviceSize blockSize = heapSize >= 1024 * 1024 * 1024 ? LARGE_BLOCK_SIZE : alignUp(heapSize / 8, MIN_SIZE);
+		for (uint32_t image = 0; image < 2; image++) {
+			mHeaps[type * 2 + image].memoryType = type;
+			mHeaps[type * 2 + image].blockSize = blockSize;
+		}
+	}
+}
+
+MemoryAllocator::~MemoryAllocator() {
+	for (Heap& heap : mHeaps) {
+		for (std::unique_ptr<Block>& block : heap.blocks) {
+			if (!block) continue;
+			if (block->mapped) mDevice.unmapMemory(block->memory);
+			mDevice.freeMemory(block->memory);
+		}
+	}
+}
+
+MemoryAllocator::Allocation MemoryAllocator::Allocate(const vk::MemoryRequirements& requirements, vk::MemoryPropertyFlags properties, bool image, Category category) {
+	uint32_t memoryType = FindMemoryType(requirements.memoryTypeBits, properties);
+	uint32_t heapIndex = memoryType * 2 + (image ? 1 : 0);
+	if (requirements.size > mHeaps[heapIndex].blockSize / 2) return allocateDedicated(requirements, memoryType, nullptr, nullptr, category);
+
+	vk::DeviceSize size = alignUp(requirements.size, MIN_SIZE);
+	vk::DeviceSize alignment = std::max(requirements.alignment, MIN_SIZE);
+
+	std::lock_guard<std::mutex> lock(mMutex);
+	Heap& heap = mHeaps[heapIndex];
+	Allocation allocation;
+	allocation.category = category;
+	allocation.memoryType = memoryType;
+	allocation.heap = heapIndex;
+	allocation.size = requirements.size;
+	for (uint32_t i = 0; i < (uint32_t)heap.blocks.size(); i++) {
+		if (heap.blocks[i] && allocateFromBlock(*heap.blocks[i], size, alignment, allocation.offset, allocation.node)) {
+			allocation.block = i;
+			break;
+		}
+	}
+	if (allocation.block == INVALID_INDEX) {
+		//Released slots are reused, block indices of live allocations never change
+		auto slot = std::find(heap.blocks.begin(), heap.blocks.end(), nullptr);
+		if (slot == heap.blocks.end()) slot = heap.blocks.insert(heap.blocks.end(), nullptr);
+		*slot = createBlock(heap);
+		allocation.block = (uint32_t)(slot - heap.blocks.begin());
+		//Anything up to half a block fits into an empty one
+		allocateFromBlock(**slot, size, alignment, allocation.offset, allocation.node);
+	}
+
+	Block& block = *heap.blocks[allocation.block];
+	block.used += block.nodes[allocation.node].size;
+	allocation.memory = block.memory;
+	if (block.mapped) allocation.mapped = block.mapped + allocation.offset;
+	trackAllocation(allocation);
+	return allocation;
+}
+
+void MemoryAllocator::Free(Allocation& allocation) {
+	if (!allocation.memory) return;
+
+	std::lock_guard<std::mutex> lock(mMutex);
+	trackFree(allocation);
+	if (allocation.heap == INVALID_INDEX) {
+		//Mapped memory is unmapped along with it
+		mDevice.freeMemory(allocation.memory);
+	} else {
+		freeToBlock(mHeaps[allocation.heap], allocation.block, allocation.node);
+	}
+	allocation = Allocation{};
+}
+
+void MemoryAllocator::CreateBuffer(vk::DeviceSize size, vk::BufferUsageFlags usage, vk::MemoryPropertyFlags properties, Category category, vk::Buffer& outBuffer, Allocation& outAllocation) {
+	outBuffer = mDevice.createBuffer(vk::BufferCreateInfo{ {}, size, usage, vk::SharingMode::eExclusive });
+
+	auto requirements = mDevice.getBufferMemoryRequirements2<vk::MemoryRequirements2, vk::MemoryDedicatedRequirements>(vk::BufferMemoryRequirementsInfo2{ outBuffer });
+	const vk::MemoryRequirements& memoryRequirements = requirements.get<vk::MemoryRequirements2>().memoryRequirements;
+	if (requirements.get<vk::MemoryDedicatedRequirements>().prefersDedicatedAllocation) {
+		outAllocation = allocateDedicated(memoryRequirements, FindMemoryType(memoryRequirements.memoryTypeBits, properties), outBuffer, nullptr, category);
+	} else {
+		outAllocation = Allocate(memoryRequirements, properties, false, category);
+	}
+	mDevice.bindBufferMemory(outBuffer, outAllocation.memory, outAllocation.offset);
+}
+
+void MemoryAllocator::CreateImage(vk::Format format, uint32_t width, uint32_t height, uint32_t mipLevels, vk::ImageUsageFlags usage, Category category, vk::Image& outImage, Allocation& outAllocation,
+	uint32_t arrayLayers, bool dedicated) {
+	vk::ImageCreateInfo info{ {}, vk::ImageType::e2D, format, {width, height, 1}, mipLevels, arrayLayers, vk::SampleCountFlagBits::e1, vk::ImageTiling::eOptimal, usage, vk::SharingMode::eExclusive, 0, nullptr, vk::ImageLayout::eUndefined };
+	outImage = mDevice.createImage(info);
+
+	auto requirements = mDevice.getImageMemoryRequirements2<vk::MemoryRequirements2, vk::MemoryDedicatedRequirements>(vk::ImageMemoryRequirementsInfo2{ outImage });
+	const vk::MemoryRequirements& memoryRequirements = requirements.get<vk::MemoryRequirements2>().memoryRequirements;
+	if (dedicated || requirements.get<vk::MemoryDedicatedRequirements>().prefersDedicatedAllocation) {
+		outAllocation = allocateDedicated(memoryRequirements, FindMemoryType(memoryRequirements.memoryTypeBits, vk::MemoryPropertyFlagBits::eDeviceLocal), nullptr, outImage, category);
+	} else {
+		outAllocation = Allocate(memoryRequirements, vk::MemoryPropertyFlagBits::eDeviceLocal, true, category);
+	}
+	mDevice.bindImageMemory(outImage, outAllocation.memory, outAllocation.offset);
+}
+
+void MemoryAllocator::DestroyBuffer(vk::Buffer& buffer, Allocation& allocation) {
+	mDevice.destroyBuffer(buffer);
+	buffer = nullptr;
+	Free(allocation);
+}
+
+void MemoryAllocator::DestroyImage(vk::Image& image, Allocation& allocation) {
+	mDevice.destroyImage(image);
+	image = nullptr;
+	Free(allocation);
+}
+
+uint32_t MemoryAllocator::FindMemoryType(uint32_t typeFilter, vk::MemoryPropertyFlags properties) const {
+	for (uint32_t i = 0; i < mMemoryProperties.memoryTypeCount; i++) {
+		if (typeFilter & (1 << i) && (mMemoryProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+			return i;
+		}
+	}
+	throw std::runtime_error("No memory type with properties " + vk::to_string(properties));
+}
+
+void MemoryAllocator::SetBudget(Category category, vk::DeviceSize budget) {
+	std::lock_guard<std::mutex> lock(mMutex);
+	mCategoryStats[(uint32_t)category].budget = budget;
+}
+
+MemoryAllocator::Stats MemoryAllocator::GetStats() const {
+	Stats stats;
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		std::copy(std::begin(mCategoryStats), std::end(mCategoryStats), std::begin(stats.categories));
+		stats.heaps = mHeapStats;
+	}
+
+	stats.memoryBudget = mMemoryBudget;
+	if (mMemoryBudget) {
+		auto properties = mPhysicalDevice.getMemoryProperties2<vk::PhysicalDeviceMemoryProperties2, vk::PhysicalDeviceMemoryBudgetPropertiesEXT>();
+		const vk::PhysicalDeviceMemoryBudgetPropertiesEXT& budget = properties.get<vk::PhysicalDeviceMemoryBudgetPropertiesEXT>();
+		for (uint32_t i = 0; i < (uint32_t)stats.heaps.size(); i++) {
+			stats.heaps[i].driverUsage = budget.heapUsage[i];
+			stats.heaps[i].driverBudget = budget.heapBudget[i];
+		}
+	}
+	return stats;
+}
+
+const char* MemoryAllocator::GetCategoryName(Category category) {
+	switch (category) {
+	case Category::Mesh: return "Mesh";
+	case Category::Texture: return "Texture";
+	case Category::Uniform: return "Uniform";
+	case Category::Depth: return "Depth";
+	case Category::Staging: return "Staging";
+	default: return "Other";
+	}
+}
+
+MemoryAllocator::Allocation MemoryAllocator::allocateDedicated(const vk::MemoryRequirements& requirements, uint32_t memoryType, vk::Buffer buffer, vk::Image image, Category category) {
+	vk::MemoryDedicatedAllocateInfo dedicatedInfo{ image, buffer };
+	vk::MemoryAllocateInfo allocateInfo{ requirements.size, memoryType };
+	if (buffer || image) allocateInfo.pNext = &dedicatedInfo;
+
+	Allocation allocation;
+	allocation.memory = mDevice.allocateMemory(allocateInfo);
+	allocation.size = requirements.size;
+	allocation.category = category;
+	allocation.memoryType = memoryType;
+	if (isHostVisible(memoryType)) allocation.mapped = (uint8_t*)mDevice.mapMemory(allocation.memory, 0, VK_WHOLE_SIZE);
+
+	std::lock_guard<std::mutex> lock(mMutex);
+	trackAllocation(allocation);
+	return allocation;
+}
+
+bool MemoryAllocator::allocateFromBlock(Block& block, vk::DeviceSize size, vk::DeviceSize alignment, vk::DeviceSize& outOffset, uint32_t& outNode) {
+	//Ranges start at multiples of MIN_SIZE, so this covers the worst case padding in front
+	vk::DeviceSize searchSize = size + alignment - MIN_SIZE;
+	//Rounded up to the next list, every range in it or above is big enough without walking the list
+	searchSize += ((vk::DeviceSize)1 << (highestBit(searchSize) - SL_BITS)) - 1;
+	uint32_t fl;
+	uint32_t sl;
+	mapping(searchSize, fl, sl);
+	if (fl >= FL_COUNT) return false;
+
+	uint32_t slMap = block.slBitmap[fl] & (~0u << sl);
+	if (!slMap) {
+		uint32_t flMap = fl + 1 < FL_COUNT ? block.flBitmap & (~0u << (fl + 1)) : 0;
+		if (!flMap) return false;
+		fl = lowestBit(flMap);
+		slMap = block.slBitmap[fl];
+	}
+	sl = lowestBit(slMap);
+	uint32_t nodeIndex = block.freeHeads[fl][sl];
+	removeFree(block, nodeIndex);
+
+	vk::DeviceSize padding = alignUp(block.nodes[nodeIndex].offset, alignment) - block.nodes[nodeIndex].offset;
+	if (padding > 0) {
+		//The padding stays free as its own range in front
+		uint32_t front = newNode(block);
+		Node& node = block.nodes[nodeIndex];
+		block.nodes[front] = Node{ node.offset, padding, node.prevPhysical, nodeIndex, INVALID_INDEX, INVALID_INDEX, false };
+		if (node.prevPhysical != INVALID_INDEX) block.nodes[node.prevPhysical].nextPhysical = front;
+		node.prevPhysical = front;
+		node.offset += padding;
+		node.size -= padding;
+		insertFree(block, front);
+	}
+	splitTail(block, nodeIndex, size);
+
+	outOffset = block.nodes[nodeIndex].offset;
+	outNode = nodeIndex;
+	return true;
+}
+
+std::unique_ptr<MemoryAllocator::Block> MemoryAllocator::createBlock(const Heap& heap) {
+	std::unique_ptr<Block> block = std::make_unique<Block>();
+	block->memory = mDevice.allocateMemory(vk::MemoryAllocateInfo{ heap.blockSize, heap.memoryType });
+	if (isHostVisible(heap.memoryType)) block->mapped = (uint8_t*)mDevice.mapMemory(block->memory, 0, VK_WHOLE_SIZE);
+	HeapStats& heapStats = mHeapStats[mMemoryProperties.memoryTypes[heap.memoryType].heapIndex];
+	heapStats.blocks++;
+	heapStats.allocated += heap.blockSize;
+
+	std::fill(&block->freeHeads[0][0], &block->freeHeads[0][0] + FL_COUNT * SL_COUNT, INVALID_INDEX);
+	uint32_t node = newNode(*block);
+	block->nodes[node] = Node{ 0, heap.blockSize, INVALID_INDEX, INVALID_INDEX, INVALID_INDEX, INVALID_INDEX, false };
+	insertFree(*block, node);
+	return block;
+}
+
+void MemoryAllocator::freeToBlock(Heap& heap, uint32_t blockIndex, uint32_t nodeIndex) {
+	Block& block = *heap.blocks[blockIndex];
+	block.used -= block.nodes[nodeIndex].size;
+
+	//Free neighbours are merged right away, so two free ranges are never next to each other
+	uint32_t prev = block.nodes[nodeIndex].prevPhysical;
+	if (prev != INVALID_INDEX && block.nodes[prev].free) {
+		removeFree(block, prev);
+		uint32_t next = block.nodes[nodeIndex].nextPhysical;
+		block.nodes[prev].size += block.nodes[nodeIndex].size;
+		block.nodes[prev].nextPhysical = next;
+		if (next != INVALID_INDEX) block.nodes[next].prevPhysical = prev;
+		block.unusedNodes.push_back(nodeIndex);
+		nodeIndex = prev;
+	}
+	uint32_t next = block.nodes[nodeIndex].nextPhysical;
+	if (next != INVALID_INDEX && block.nodes[next].free) {
+		removeFree(block, next);
+		uint32_t afterNext = block.nodes[next].nextPhysical;
+		block.nodes[nodeIndex].size += block.nodes[next].size;
+		block.nodes[nodeIndex].nextPhysical = afterNext;
+		if (afterNext != INVALID_INDEX) block.nodes[afterNext].prevPhysical = nodeIndex;
+		block.unusedNodes.push_back(next);
+	}
+	insertFree(block, nodeIndex);
+
+	//One empty block per heap is kept, so a heap does not allocate and free blocks over and over
+	if (block.used > 0) return;
+	for (uint32_t i = 0; i < (uint32_t)heap.blocks.size(); i++) {
+		if (i == blockIndex || !heap.blocks[i] || heap.blocks[i]->used > 0) continue;
+		if (block.mapped) mDevice.unmapMemory(block.memory);
+		mDevice.freeMemory(block.memory);
+		heap.blocks[blockIndex].reset();
+		HeapStats& heapStats = mHeapStats[mMemoryProperties.memoryTypes[heap.memoryType].heapIndex];
+		heapStats.blocks--;
+		heapStats.allocated -= heap.blockSize;
+		return;
+	}
+}
+
+bool MemoryAllocator::isHostVisible(uint32_t memoryType) const {
+	return (bool)(mMemoryProperties.memoryTypes[memoryType].propertyFlags & vk::MemoryPropertyFlagBits::eHostVisible);
+}
+
+void MemoryAllocator::trackAllocation(const Allocation& allocation) {
+	HeapStats& heapStats = mHeapStats[mMemoryProperties.memoryTypes[allocation.memoryType].heapIndex];
+	heapStats.used += allocation.size;
+	if (allocation.heap == INVALID_INDEX) {
+		heapStats.dedicated++;
+		heapStats.allocated += allocation.size;
+	}
+
+	CategoryStats& stats = mCategoryStats[(uint32_t)allocation.category];
+	bool overBudget = stats.budget > 0 && stats.size > stats.budget;
+	stats.allocations++;
+	stats.size += allocation.size;
+	stats.peak = std::max(stats.peak, stats.size);
+	//Only reported when crossing it, not for every allocation above
+	if (!overBudget && stats.budget > 0 && stats.size > stats.budget) {
+		std::cout << "Memory budget exceeded for " << GetCategoryName(allocation.category) << ": " << stats.size << " of " << stats.budget << " bytes" << std::endl;
+	}
+}
+
+void MemoryAllocator::trackFree(const Allocation& allocation) {
+	HeapStats& heapStats = mHeapStats[mMemoryProperties.memoryTypes[allocation.memoryType].heapIndex];
+	heapStats.used -= allocation.size;
+	if (allocation.heap == INVALID_INDEX) {
+		heapStats.dedicated--;
+		heapStats.allocated -= allocation.size;
+	}
+
+	CategoryStats& stats = mCategoryStats[(uint32_t)allocation.category];
+	stats.allocations--;
+	stats.size -= allocation.size;
+}
+
+void MemoryAllocator::mapping(vk::DeviceSize size, uint32_t& fl, uint32_t& sl) {
+	uint32_t log2 = highestBit(size);
+	sl = (uint32_t)(size >> (log2 - SL_BITS)) & (SL_COUNT - 1);
+	fl = log2 - MIN_SIZE_LOG2;
+}
+
+uint32_t MemoryAllocator::newNode(Block& block) {
+	if (!block.unusedNodes.empty()) {
+		uint32_t index = block.unusedNodes.back();
+		block.unusedNodes.pop_back();
+		return index;
+	}
+	block.nodes.push_back(Node{});
+	return (uint32_t)block.nodes.size() - 1;
+}
+
+void MemoryAllocator::insertFree(Block& block, uint32_t nodeIndex) {
+	uint32_t fl;
+	uint32_t sl;
+	mapping(block.nodes[nodeIndex].size, fl, sl);
+
+	Node& node = block.nodes[nodeIndex];
+	node.free = true;
+	node.prevFree = INVALID_INDEX;
+	node.nextFree = block.freeHeads[fl][sl];
+	if (node.nextFree != INVALID_INDEX) block.nodes[node.nextFree].prevFree = nodeIndex;
+	block.freeHeads[fl][sl] = nodeIndex;
+	block.flBitmap |= 1u << fl;
+	block.slBitmap[fl] |= 1u << sl;
+}
+
+void MemoryAllocator::removeFree(Block& block, uint32_t nodeIndex) {
+	uint32_t fl;
+	uint32_t sl;
+	mapping(block.nodes[nodeIndex].size, fl, sl);
+
+	Node& node = block.nodes[nodeIndex];
+	if (node.prevFree != INVALID_INDEX) block.nodes[node.prevFree].nextFree = node.nextFree;
+	else block.freeHeads[fl][sl] = node.nextFree;
+	if (node.nextFree != INVALID_INDEX) block.nodes[node.nextFree].prevFree = node.prevFree;
+	node.free = false;
+
+	if (block.freeHeads[fl][sl] == INVALID_INDEX) {
+		block.slBitmap[fl] &= ~(1u << sl);
+		if (!block.slBitmap[fl]) block.flBitmap &= ~(1u << fl);
+	}
+}
+
+void MemoryAllocator::splitTail(Block& block, uint32_t nodeIndex, vk::DeviceSize size) {
+	//Sizes are multiples of MIN_SIZE, so any rest is worth its own range
+	if (block.nodes[nodeIndex].size == size) return;
+
+	uint32_t tail = newNode(block);
+	Node& node = block.nodes[nodeIndex];
+	block.nodes[tail] = Node{ node.offset + size, node.size - size, nodeIndex, node.nextPhysical, INVALID_INDEX, INVALID_INDEX, false };
+	if (node.nextPhysical != INVALID_INDEX) block.nodes[node.nextPhysical].prevPhysical = tail;
+	node.nextPhysical = tail;
+	node.size = size;
+	insertFree(block, tail);
+}
+
+LinearPool::LinearPool(MemoryAllocator& allocator, vk::DeviceSize size, vk::BufferUsageFlags usage, vk::MemoryPropertyFlags properties, MemoryAllocator::Category category) :
+	mSize(size) {
+	mAllocator = &allocator;
+	allocator.CreateBuffer(size, usage, properties, category, mBuffer, mAllocation);
+}
+
+LinearPool::~LinearPool() {
+	mAllocator->DestroyBuffer(mBuffer, mAllocation);
+}
+
+bool LinearPool::Allocate(vk::DeviceSize size, vk::DeviceSize alignment, Range& outRange) {
+	vk::DeviceSize offset = alignUp(mHead, std::max(alignment, (vk::DeviceSize)1));
+	if (offset + size > mSize) return false;
+
+	mHead = offset + size;
+	outRange = Range{ mBuffer, offset, mAllocation.mapped ? mAllocation.mapped + offset : nullptr };
+	return true;
+}
@@ -0,0 +1,210 @@
+#pragma once
+
+#include "vulkan/vulkan.hpp"
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/*
+	Sub-allocates device memory out of large blocks instead of calling vkAllocateMemory per resource.
+	Every memory type has two heaps of blocks, one for buffers and one for images, so bufferImageGranularity
+	never has to be considered. Free ranges in a block are kept with TLSF (two level segregated fit), which
+	finds a fitting range and merges freed neighbours in constant time.
+	Resources the driver wants dedicated memory for and anything bigger than half a block get their own
+	vkAllocateMemory. Host visible blocks stay mapped for their whole lifetime.
+	Every allocation is tagged with what it is used for, live totals per category and per heap are kept for
+	the memory overlay. Thread safe.
+*/
+class MemoryAllocator {
+public:
+	static constexpr uint32_t INVALID_INDEX = ~0u;
+
+	enum class Category : uint32_t {
+		Mesh,
+		Texture,
+		Uniform,
+		Depth,
+		Staging,
+		Other,
+		Count
+	};
+
+	struct Allocation {
+		vk::DeviceMemory memory;
+		vk::DeviceSize offset = 0;
+		vk::DeviceSize size = 0;
+		uint8_t* mapped = nullptr; //host visible memory only, already offset
+		Category category = Category::Other;
+
+		//Where the range came from, only used by the allocator
+		uint32_t memoryType = INVALID_INDEX;
+		uint32_t heap = INVALID_INDEX; //INVALID_INDEX for dedicated allocations
+		uint32_t block = INVALID_INDEX;
+		uint32_t node = INVALID_INDEX;
+	};
+
+	struct CategoryStats {
+		uint32_t allocations = 0;
+		vk::DeviceSize size = 0;
+		vk::DeviceSize peak = 0;
+		vk::DeviceSize budget = 0; //0 if there is none
+	};
+	/* One per vk::MemoryHeap */
+	struct HeapStats {
+		vk::DeviceSize heapSize = 0;
+		bool deviceLocal = false;
+		uint32_t blocks = 0;
+		uint32_t dedicated = 0;
+		vk::DeviceSize allocated = 0; //device memory of all blocks and dedicated allocations
+		vk::DeviceSize used = 0; //handed out of it
+		//What the driver reports for the whole process, 0 without VK_EXT_memory_budget
+		vk::DeviceSize driverUsage = 0;
+		vk::DeviceSize driverBudget = 0;
+	};
+	struct Stats {
+		CategoryStats categories[(uint32_t)Category::Count];
+		std::vector<HeapStats> heaps;
+		bool memoryBudget = false;
+	};
+
+public:
+	/*
+		memoryBudget tells if VK_EXT_memory_budget is enabled on the device.
+		Textures start with half of the largest device local heap as budget, meshes with a quarter.
+	*/
+	MemoryAllocator(vk::Device device, vk::PhysicalDevice physDevice, bool memoryBudget);
+	/* Frees all blocks, allocations still alive are gone with them */
+	~MemoryAllocator();
+	MemoryAllocator(const MemoryAllocator&) = delete;
+	MemoryAllocator& operator=(const MemoryAllocator&) = delete;
+
+	/* image selects the heap, linear and optimal resources never share a block */
+	Allocation Allocate(const vk::MemoryRequirements& requirements, vk::MemoryPropertyFlags properties, bool image, Category category);
+	/* Resets the allocation, freeing an empty one does nothing */
+	void Free(Allocation& allocation);
+
+	/* Created, allocated and bound */
+	void CreateBuffer(vk::DeviceSize size, vk::BufferUsageFlags usage, vk::MemoryPropertyFlags properties, Category category, vk::Buffer& outBuffer, Allocation& outAllocation);
+	/* 2D optimal tiling image in device local memory, dedicated forces its own allocation, meant for render targets */
+	void CreateImage(vk::Format format, uint32_t width, uint32_t height, uint32_t mipLevels, vk::ImageUsageFlags usage, Category category, vk::Image& outImage, Allocation& outAllocation,
+		uint32_t arrayLayers = 1, bool dedicated = false);
+	void DestroyBuffer(vk::Buffer& buffer, Allocation& allocation);
+	void DestroyImage(vk::Image& image, Allocation& allocation);
+
+	uint32_t FindMemoryType(uint32_t typeFilter, vk::MemoryPropertyFlags properties) const;
+
+	/* Going over a budget only warns, allocations never fail because of it. 0 removes the budget */
+	void SetBudget(Category category, vk::DeviceSize budget);
+	/* Queries the driver budget as well, fine once per frame */
+	Stats GetStats() const;
+	static const char* GetCategoryName(Category category);
+
+private:
+	//Block size on heaps of at least 1GB, smaller heaps use an eighth of their size
+	const vk::DeviceSize LARGE_BLOCK_SIZE = 64 * 1024 * 1024;
+
+	//TLSF splits every power of two size class into 2^SL_BITS lists
+	static const uint32_t SL_BITS = 4;
+	static const uint32_t SL_COUNT = 1 << SL_BITS;
+	//Ranges are handed out in multiples of 256 bytes, which also covers the buffer offset alignments
+	static const uint32_t MIN_SIZE_LOG2 = 8;
+	static constexpr vk::DeviceSize MIN_SIZE = 1 << MIN_SIZE_LOG2;
+	static const uint32_t FL_COUNT = 32;
+
+	struct Node {
+		vk::DeviceSize offset;
+		vk::DeviceSize size;
+		uint32_t prevPhysical;
+		uint32_t nextPhysical;
+		uint32_t prevFree;
+		uint32_t nextFree;
+		bool free;
+	};
+	struct Block {
+		vk::DeviceMemory memory;
+		uint8_t* mapped = nullptr;
+		vk::DeviceSize used = 0;
+		std::vector<Node> nodes;
+		std::vector<uint32_t> unusedNodes; //slots in nodes to reuse
+		uint32_t flBitmap = 0;
+		uint32_t slBitmap[FL_COUNT] = {};
+		uint32_t freeHeads[FL_COUNT][SL_COUNT];
+	};
+	struct Heap {
+		uint32_t memoryType;
+		vk::DeviceSize blockSize;
+		std::vector<std::unique_ptr<Block>> blocks; //nullptr for released slots
+	};
+
+	Allocation allocateDedicated(const vk::MemoryRequirements& requirements, uint32_t memoryType, vk::Buffer buffer, vk::Image image, Category category);
+	bool allocateFromBlock(Block& block, vk::DeviceSize size, vk::DeviceSize alignment, vk::DeviceSize& outOffset, uint32_t& outNode);
+	std::unique_ptr<Block> createBlock(const Heap& heap);
+	void freeToBlock(Heap& heap, uint32_t blockIndex, uint32_t nodeIndex);
+	bool isHostVisible(uint32_t memoryType) const;
+	//Both expect mMutex to be held
+	void trackAllocation(const Allocation& allocation);
+	void trackFree(const Allocation& allocation);
+
+	//TLSF internals, work on a single block
+	static void mapping(vk::DeviceSize size, uint32_t& fl, uint32_t& sl);
+	static uint32_t newNode(Block& block);
+	static void insertFree(Block& block, uint32_t nodeIndex);
+	static void removeFree(Block& block, uint32_t nodeIndex);
+	/* Splits everything behind the first size bytes of a node off as a free range */
+	static void splitTail(Block& block, uint32_t nodeIndex, vk::DeviceSize size);
+
+private:
+	vk::Device mDevice;
+	vk::PhysicalDevice mPhysicalDevice;
+	vk::PhysicalDeviceMemoryProperties mMemoryProperties;
+	bool mMemoryBudget;
+
+	mutable std::mutex mMutex;
+	//Indexed by memory type * 2 + 1 for images
+	std::vector<Heap> mHeaps;
+	CategoryStats mCategoryStats[(uint32_t)Category::Count];
+	std::vector<HeapStats> mHeapStats; //without the driver values
+};
+
+/*
+	Bump allocator over a single buffer for transient data that is thrown away all at once,
+	like per frame uploads. Ranges are only valid until the next Reset(). Not thread safe.
+*/
+class LinearPool {
+public:
+	struct Range {
+		vk::Buffer buffer;
+		vk::DeviceSize offset;
+		uint8_t* mapped; //nullptr if the pool is not host visible
+	};
+
+public:
+	LinearPool(MemoryAllocator& allocator, vk::DeviceSize size, vk::BufferUsageFlags usage, vk::MemoryPropertyFlags properties, MemoryAllocator::Category category);
+	~LinearPool();
+	LinearPool(const LinearPool&) = delete;
+	LinearPool& operator=(const LinearPool&) = delete;
+
+	/* False if the rest of the pool is too small */
+	bool Allocate(vk::DeviceSize size, vk::DeviceSize alignment, Range& outRange);
+	void Reset() {
+		mHead = 0;
+	}
+
+	vk::Buffer GetBuffer() const {
+		return mBuffer;
+	}
+	vk::DeviceSize GetSize() const {
+		return mSize;
+	}
+	vk::DeviceSize GetUsed() const {
+		return mHead;
+	}
+
+private:
+	MemoryAllocator* mAllocator;
+	vk::Buffer mBuffer;
+	MemoryAllocator::Allocation mAllocation;
+	vk::DeviceSize mSize;
+	vk::DeviceSize mHead = 0;
+};
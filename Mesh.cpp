@@ -0,0 +1,205 @@
+#include "Mesh.h"
+
+#include <cfloat>
+
+void Mesh::LoadMeshData(const aiMesh* curMesh, Data& outData) {
+	std::vector<Vertex>& vertices = outData.vertices;
+	vertices.resize(curMesh->mNumVertices);
+	float scale = 0.01f;
+	for (uint32_t i = 0; i < curMesh->mNumVertices; i++) {
+		vertices[i].pos = { curMesh->mVertices[i].x * scale, curMesh->mVertices[i].y * scale, curMesh->mVertices[i].z * scale };
+		vertices[i].uv = { curMesh->mTextureCoords[0][i].x, curMesh->mTextureCoords[0][i].y };
+	}
+
+	std::vector<uint32_t>& indices = outData.indices32;
+	indices.resize(curMesh->mNumFaces * 3);
+	for (uint32_t i = 0; i < curMesh->mNumFaces; i++) {
+		indices[(i * 3) + 0] = curMesh->mFaces[i].mIndices[0];
+		indices[(i * 3) + 1] = curMesh->mFaces[i].mIndices[1];
+		indices[(i * 3) + 2] = curMesh->mFaces[i].mIndices[2];
+	}
+
+	outData.materialIndex = curMesh->mMaterialIndex;
+
+	outData.Optimize();
+	outData.BuildLods();
+	outData.BuildMeshlets();
+	outData.Finalize();
+}
+
+void Mesh::Data::Optimize() {
+	const float OVERDRAW_THRESHOLD = 1.05f;
+	size_t indexCount = indices32.size();
+	importStats = MeshOptimizer::analyzeVertexCache(indices32.data(), indexCount, vertices.size());
+
+	std::vector<uint32_t> clusters;
+	MeshOptimizer::optimizeVertexCache(indices32.data(), indices32.data(), indexCount, vertices.size(), MeshOptimizer::CACHE_SIZE, clusters);
+	if (!vertices.empty()) {
+		MeshOptimizer::optimizeOverdraw(indices32.data(), indices32.data(), indexCount, &vertices[0].pos.x, sizeof(Vertex), vertices.size(),
+			clusters, MeshOptimizer::CACHE_SIZE, OVERDRAW_THRESHOLD);
+	}
+
+	std::vector<uint32_t> remap;
+	size_t usedVertices = MeshOptimizer::optimizeVertexFetchRemap(indices32.data(), indexCount, vertices.size(), remap);
+	MeshOptimizer::remapVertices(vertices, remap, usedVertices);
+
+	optimizedStats = MeshOptimizer::analyzeVertexCache(indices32.data(), indexCount, vertices.size());
+}
+
+void Mesh::Data::BuildLods() {
+	//Every level aims for half the triangles of the previous one
+	const float LOD_REDUCTION = 0.5f;
+	//Border and seam vertices are locked, stop once they keep the simplifier from making real progress
+	const float MIN_REDUCTION = 0.85f;
+	const size_t MIN_INDEX_COUNT = 3 * 16;
+
+	size_t baseIndexCount = indices32.size();
+	lods.assign(1, Lod{ 0, (uint32_t)baseIndexCount, 0.0f, 0, 0 });
+	if (vertices.empty()) return;
+
+	std::vector<uint32_t> lodIndices(baseIndexCount);
+	std::vector<uint32_t> clusters;
+	while (lods.size() < MAX_LODS) {
+		size_t previousCount = lods.back().indexCount;
+		size_t targetCount = (size_t)(previousCount / 3 * LOD_REDUCTION) * 3;
+		if (targetCount < MIN_INDEX_COUNT) break;
+
+		//Always simplify the full mesh, so the error is measured against the original surface
+		float error = 0.0f;
+		size_t lodCount = MeshOptimizer::simplify(lodIndices.data(), indices32.data(), baseIndexCount, &vertices[0].pos.x, sizeof(Vertex), vertices.size(),
+			targetCount, FLT_MAX, &error);
+		if (lodCount > previousCount * MIN_REDUCTION) break;
+
+		MeshOptimizer::optimizeVertexCache(lodIndices.data(), lodIndices.data(), lodCount, vertices.size(), MeshOptimizer::CACHE_SIZE, clusters);
+		lods.push_back(Lod{ (uint32_t)indices32.size(), (uint32_t)lodCount, error, 0, 0 });
+		indices32.insert(indices32.end(), lodIndices.begin(), lodIndices.begin() + lodCount);
+	}
+}
+
+void Mesh::Data::BuildMeshlets() {
+	meshlets.clear();
+	if (vertices.empty()) return;
+
+	std::vector<MeshOptimizer::Meshlet> ranges;
+	for (Lod& lod : lods) {
+		ranges.clear();
+		MeshOptimizer::buildMeshlets(&indices32[lod.firstIndex], lod.indexCount, vertices.size(), MeshOptimizer::MESHLET_MAX_VERTICES, MeshOptimizer::MESHLET_MAX_TRIANGLES, ranges);
+
+		lod.firstMeshlet = (uint32_t)meshlets.size();
+		lod.meshletCount = (uint32_t)ranges.size();
+		for (const MeshOptimizer::Meshlet& range : ranges) {
+			uint32_t firstIndex = lod.firstIndex + range.firstIndex;
+			MeshOptimizer::MeshletBounds bounds = MeshOptimizer::computeMeshletBounds(&indices32[firstIndex], range.indexCount, &vertices[0].pos.x, sizeof(Vertex),
+				FRONT_FACE == vk::FrontFace::eClockwise);
+
+			Meshlet meshlet;
+			meshlet.firstIndex = firstIndex;
+			meshlet.indexCount = range.indexCount;
+			meshlet.boundingSphere = glm::vec4(bounds.center[0], bounds.center[1], bounds.center[2], bounds.radius);
+			meshlet.cone = glm::vec4(bounds.coneAxis[0], bounds.coneAxis[1], bounds.coneAxis[2], bounds.coneCutoff);
+			meshlets.push_back(meshlet);
+		}
+	}
+}
+
+void Mesh::Data::Finalize() {
+	indexType = ChooseIndexType(vertices.size());
+	if (indexType == vk::IndexType::eUint16) {
+		indices16.assign(indices32.begin(), indices32.end());
+		indices32.clear();
+		indices32.shrink_to_fit();
+	}
+
+	glm::vec3 boundsMin(FLT_MAX);
+	glm::vec3 boundsMax(-FLT_MAX);
+	for (const Vertex& v : vertices) {
+		boundsMin = glm::min(boundsMin, v.pos);
+		boundsMax = glm::max(boundsMax, v.pos);
+	}
+	if (vertices.empty()) boundsMin = boundsMax = glm::vec3(0.0f);
+
+	glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+	float radius = 0.0f;
+	for (const Vertex& v : vertices) radius = std::max(radius, glm::length(v.pos - center));
+	boundingSphere = glm::vec4(center, radius);
+
+	Pack();
+}
+
+void Mesh::Data::Pack() {
+	glm::vec3 boundsMin(FLT_MAX);
+	glm::vec3 boundsMax(-FLT_MAX);
+	for (const Vertex& v : vertices) {
+		boundsMin = glm::min(boundsMin, v.pos);
+		boundsMax = glm::max(boundsMax, v.pos);
+	}
+	if (vertices.empty()) boundsMin = boundsMax = glm::vec3(0.0f);
+
+	decode = VertexFormat::GpuVertex::computeDecode(boundsMin, boundsMax);
+	gpuVertices.resize(vertices.size());
+	for (size_t i = 0; i < vertices.size(); i++) {
+		gpuVertices[i] = VertexFormat::GpuVertex::encode(vertices[i].pos, vertices[i].uv, decode);
+	}
+}
+
+Mesh::Geometry Mesh::Data::GetGeometry() const {
+	Geometry geometry{};
+	geometry.vertices = gpuVertices.data();
+	geometry.vertexCount = (uint32_t)gpuVertices.size();
+	geometry.indexType = indexType;
+	if (indexType == vk::IndexType::eUint16) {
+		geometry.indices = indices16.data();
+		geometry.indexCount = (uint32_t)indices16.size();
+	} else {
+		geometry.indices = indices32.data();
+		geometry.indexCount = (uint32_t)indices32.size();
+	}
+	geometry.decode = decode;
+	geometry.lods = lods.data();
+	geometry.lodCount = (uint32_t)lods.size();
+	geometry.meshlets = meshlets.data();
+	geometry.meshletCount = (uint32_t)meshlets.size();
+	geometry.boundingSphere = boundingSphere;
+	geometry.materialIndex = materialIndex;
+	return geometry;
+}
+
+void Mesh::DrawCulled(const vk::CommandBuffer& cmdBuffer, uint32_t lod, const CullInfo& cull, CullStats& stats) {
+	const Lod& level = mLods[lod];
+	stats.meshlets += level.meshletCount;
+	if (cull.frustumCulling && !isSphereVisible(mBoundingSphere, cull.frustumPlanes)) return;
+
+	uint32_t runStart = 0;
+	uint32_t runCount = 0;
+	auto flushRun = [&]() {
+		if (runCount == 0) return;
+		cmdBuffer.drawIndexed(runCount, 1, mAllocation.firstIndex + runStart, mAllocation.vertexOffset, 0);
+		stats.draws++;
+		stats.triangles += runCount / 3;
+		runCount = 0;
+	};
+
+	for (uint32_t i = level.firstMeshlet; i < level.firstMeshlet + level.meshletCount; i++) {
+		const Meshlet& meshlet = mMeshlets[i];
+
+		bool visible = !cull.frustumCulling || isSphereVisible(meshlet.boundingSphere, cull.frustumPlanes);
+		if (visible && cull.coneCulling) {
+			glm::vec3 toCenter = glm::vec3(meshlet.boundingSphere) - cull.cameraPos;
+			visible = glm::dot(toCenter, glm::vec3(meshlet.cone)) < meshlet.cone.w * glm::length(toCenter) + meshlet.boundingSphere.w;
+		}
+		if (!visible) {
+			flushRun();
+			continue;
+		}
+
+		stats.visibleMeshlets++;
+		if (runCount > 0 && runStart + runCount == meshlet.firstIndex) {
+			runCount += meshlet.indexCount;
+		} else {
+			flushRun();
+			runStart = meshlet.firstIndex;
+			runCount = meshlet.indexCount;
+		}
+	}
+	flushRun();
+}
@@ -2,114 +2,220 @@
 
 #include "GraphicsVulkan.h"
 #include "VulkanUtils.h"
+#include "UploadBatcher.h"
+#include "GeometryPool.h"
+#include "VertexFormat.h"
+#include "MeshOptimizer.h"
 
 #define GLM_FORCE_RADIANS
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
-
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
 
+#include <limits>
+
 class Mesh {
-private:
-	const vk::MemoryPropertyFlags HOST_LOCAL = vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent;
+public:
+	static const uint32_t MAX_LODS = 5;
+	/*
+		Front face of the scene pipeline. With the y flipped projection, clockwise on screen are the triangles whose
+		cross(p1 - p0, p2 - p0) points away from the viewer, the meshlet cones are built for that side.
+	*/
+	static constexpr vk::FrontFace FRONT_FACE = vk::FrontFace::eClockwise;
+
+	//Full precision vertex used while importing and processing, GPU gets VertexFormat::GpuVertex
 	struct Vertex {
 		glm::vec3 pos;
-		glm::vec3 color;
 		glm::vec2 uv;
 	};
+	/* Index range of one level of detail, error is the simplification error in world units */
+	struct Lod {
+		uint32_t firstIndex;
+		uint32_t indexCount;
+		float error;
+		uint32_t firstMeshlet;
+		uint32_t meshletCount;
+	};
+	/* Cluster of up to 124 triangles, see MeshOptimizer::MeshletBounds for the cone test */
+	struct Meshlet {
+		uint32_t firstIndex;
+		uint32_t indexCount;
+		glm::vec4 boundingSphere; //xyz center, w radius
+		glm::vec4 cone; //xyz axis, w cutoff
+	};
+	struct CullInfo {
+		glm::vec4 frustumPlanes[6];
+		glm::vec3 cameraPos;
+		bool frustumCulling;
+		bool coneCulling;
+	};
+	struct CullStats {
+		uint32_t meshlets;
+		uint32_t visibleMeshlets;
+		uint32_t draws;
+		uint32_t triangles;
+	};
+	/* Non-owning view of an uploadable mesh, indices are uint16_t or uint32_t depending on indexType */
+	struct Geometry {
+		const VertexFormat::GpuVertex* vertices;
+		uint32_t vertexCount;
+		const void* indices;
+		uint32_t indexCount;
+		vk::IndexType indexType;
+		VertexFormat::Decode decode;
+		const Lod* lods;
+		uint32_t lodCount;
+		const Meshlet* meshlets;
+		uint32_t meshletCount;
+		glm::vec4 boundingSphere; //xyz center, w radius
+		uint32_t materialIndex;
+	};
+	/* Owning CPU side mesh, only one of the index vectors is filled */
+	struct Data {
+		std::vector<Vertex> vertices;
+		std::vector<uint16_t> indices16;
+		std::vector<uint32_t> indices32;
+		vk::IndexType indexType = vk::IndexType::eUint16;
+
+		std::vector<Lod> lods;
+		std::vector<Meshlet> meshlets;
+		glm::vec4 boundingSphere = glm::vec4(0.0f);
+		uint32_t materialIndex = 0;
+
+		std::vector<VertexFormat::GpuVertex> gpuVertices;
+		VertexFormat::Decode decode;
+
+		//Vertex cache efficiency before and after Optimize()
+		MeshOptimizer::CacheStats importStats{};
+		MeshOptimizer::CacheStats optimizedStats{};
+
+		/*
+			Reorders triangles for the post transform cache, then for overdraw, then vertices for fetch locality.
+			Works on indices32, so it has to run before Finalize().
+		*/
+		void Optimize();
+		/* Appends simplified index lists for up to MAX_LODS - 1 coarser levels to indices32 */
+		void BuildLods();
+		/* Splits every lod into meshlets with bounds for culling, call after BuildLods() */
+		void BuildMeshlets();
+		/* Narrows indices to 16 bit where possible, computes bounds and packs the vertices */
+		void Finalize();
+		/* Encodes vertices into the GPU layout, has to be called again after vertices changed */
+		void Pack();
+
+		Geometry GetGeometry() const;
+	};
 	 
 public:
-	Mesh(const GraphicsVulkan& gfx, const aiMesh* mesh) {
-		mGfx = &gfx;
-		loadMesh(mesh);
-		createBuffers(gfx.mDevice, gfx.mPhysicalDevice);
-		fillBuffers(gfx.mDevice, gfx.mPhysicalDevice, gfx.mCommandPool, gfx.mGfxQueue);
+	/* Uploads are only recorded, the mesh can be drawn after batcher.Flush() */
+	Mesh(const GraphicsVulkan& gfx, GeometryPool& pool, UploadBatcher& batcher, const aiMesh* mesh) {
+		Data data;
+		LoadMeshData(mesh, data);
+		init(gfx, pool, batcher, data.GetGeometry());
 	}
+	/* Data is only read during construction, so it may point into a mapped file */
+	Mesh(const GraphicsVulkan& gfx, GeometryPool& pool, UploadBatcher& batcher, const Geometry& geometry) {
+		init(gfx, pool, batcher, geometry);
+	}
+	/* The pool range is given back once frames in flight stopped drawing it, the pool has to outlive the mesh */
 	~Mesh() {
-		mGfx->mDevice.waitIdle();
-		mGfx->mDevice.destroyBuffer(mVertexBuffer);
-		mGfx->mDevice.destroyBuffer(mIndexBuffer);
-		mGfx->mDevice.freeMemory(mVertexBufferMemory);
-		mGfx->mDevice.freeMemory(mIndexBufferMemory);
+		mPool->Free(mAllocation);
 	}
 	Mesh(const Mesh&) = delete;
 	Mesh& operator= (const Mesh&) = delete;
 
-	void Bind(const vk::CommandBuffer& cmdBuffer) {
-		cmdBuffer.bindVertexBuffers(0, mVertexBuffer, (uint64_t)0 );
-		cmdBuffer.bindIndexBuffer(mIndexBuffer, 0, vk::IndexType::eUint16);
-	}
-
-	uint32_t GetIndexCount() {
-		return mIndexCount;
+	/* Vertex and index buffer of the pool have to be bound */
+	void Draw(const vk::CommandBuffer& cmdBuffer, uint32_t lod) {
+		const Lod& level = mLods[lod];
+		cmdBuffer.drawIndexed(level.indexCount, 1, mAllocation.firstIndex + level.firstIndex, mAllocation.vertexOffset, 0);
 	}
-
-private:
-	void loadMesh(const aiMesh* curMesh) {
-		mVertexData.resize(curMesh->mNumVertices);
-		float scale = 0.01f;
-		for (uint32_t i = 0; i < curMesh->mNumVertices; i++) {
-			mVertexData[i].pos = { curMesh->mVertices[i].x * scale, curMesh->mVertices[i].y * scale, curMesh->mVertices[i].z * scale };
-			mVertexData[i].uv = { curMesh->mTextureCoords[0][i].x, curMesh->mTextureCoords[0][i].y };
-			mVertexData[i].color = { 1.0f, 1.0f, 1.0f };
-		}
-
-		mIndexData.resize(curMesh->mNumFaces * 3);
-		for (uint32_t i = 0; i < curMesh->mNumFaces; i++) {
-			mIndexData[(i * 3) + 0] = curMesh->mFaces[i].mIndices[0];
-			mIndexData[(i * 3) + 1] = curMesh->mFaces[i].mIndices[1];
-			mIndexData[(i * 3) + 2] = curMesh->mFaces[i].mIndices[2];
+	/*
+		Draws only the meshlets of a lod that pass the frustum and normal cone tests.
+		Meshlets are contiguous in the index buffer, so runs of visible meshlets are merged into one draw.
+	*/
+	void DrawCulled(const vk::CommandBuffer& cmdBuffer, uint32_t lod, const CullInfo& cull, CullStats& stats);
+
+	/*
+		Picks the coarsest level whose error stays below maxPixelError on screen.
+		projectionScale is the size in pixels of one unit at distance one.
+	*/
+	uint32_t SelectLod(const glm::vec3& cameraPos, float projectionScale, float maxPixelError) const {
+		float distance = glm::length(glm::vec3(mBoundingSphere) - cameraPos) - mBoundingSphere.w;
+		if (distance <= 0.0f) return 0;
+
+		for (uint32_t lod = (uint32_t)mLods.size() - 1; lod > 0; lod--) {
+			if (mLods[lod].error * projectionScale / distance <= maxPixelError) return lod;
 		}
-
-
-		mIndexCount = mIndexData.size();
+		return 0;
 	}
-	void createBuffers(vk::Device device, vk::PhysicalDevice physDevice) {
-		uint32_t vertexDataSize = sizeof(Vertex) * mVertexData.size();
-		uint32_t indexDataSize = sizeof(uint16_t) * mIndexData.size();
 
-		VulkanUtils::createBuffer(device, physDevice, vertexDataSize, vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eTransferDst, vk::MemoryPropertyFlagBits::eDeviceLocal, mVertexBuffer, mVertexBufferMemory);
-		VulkanUtils::createBuffer(device, physDevice, indexDataSize, vk::BufferUsageFlagBits::eIndexBuffer | vk::BufferUsageFlagBits::eTransferDst, vk::MemoryPropertyFlagBits::eDeviceLocal, mIndexBuffer, mIndexBufferMemory);
+	/* Diameter of the bounding sphere in pixels, infinite if the camera is inside */
+	float GetScreenSize(const glm::vec3& cameraPos, float projectionScale) const {
+		float distance = glm::length(glm::vec3(mBoundingSphere) - cameraPos) - mBoundingSphere.w;
+		if (distance <= 0.0f) return std::numeric_limits<float>::infinity();
+		return 2.0f * mBoundingSphere.w * projectionScale / distance;
 	}
-	void fillBuffers(vk::Device device, vk::PhysicalDevice physDevice, vk::CommandPool pool, vk::Queue queue) {
-		uint32_t vertexDataSize = sizeof(Vertex) * mVertexData.size();
-		uint32_t indexDataSize = sizeof(uint16_t) * mIndexData.size();
 
-		vk::Buffer tmpBuffer;
-		vk::DeviceMemory tmpMemory;
+	/* Index into the material list of the scene the mesh was loaded from */
+	uint32_t GetMaterialIndex() {
+		return mMaterialIndex;
+	}
+	uint32_t GetLodCount() {
+		return (uint32_t)mLods.size();
+	}
+	uint32_t GetIndexCount(uint32_t lod) {
+		return mLods[lod].indexCount;
+	}
+	vk::IndexType GetIndexType() {
+		return mAllocation.indexType;
+	}
+	const VertexFormat::Decode& GetVertexDecode() {
+		return mDecode;
+	}
 
-		VulkanUtils::createBuffer(device, physDevice, vertexDataSize, vk::BufferUsageFlagBits::eTransferSrc, HOST_LOCAL, tmpBuffer, tmpMemory);
-		void* data = device.mapMemory(tmpMemory, 0, vertexDataSize);
-		memcpy(data, mVertexData.data(), vertexDataSize);
-		device.unmapMemory(tmpMemory);
-		mVertexData.clear();
+	static uint32_t GetIndexSize(vk::IndexType indexType) {
+		return indexType == vk::IndexType::eUint16 ? sizeof(uint16_t) : sizeof(uint32_t);
+	}
+	/* 16 bit indices halve index fetch bandwidth, but can only address 65536 vertices */
+	static vk::IndexType ChooseIndexType(size_t vertexCount) {
+		return vertexCount <= 0x10000 ? vk::IndexType::eUint16 : vk::IndexType::eUint32;
+	}
 
-		VulkanUtils::copyBuffer(device, pool, queue, tmpBuffer, mVertexBuffer, vertexDataSize);
+	/* Converts, optimizes and packs an imported mesh, safe to call from worker threads */
+	static void LoadMeshData(const aiMesh* curMesh, Data& outData);
 
-		//Not creating new buffer, because indexdatasize should be less than vertexdatasize
-		if (indexDataSize > vertexDataSize) throw std::runtime_error("There was some lazy assertion that is not fullfilled: vertex <  index. have fun finding out what that means!!");
-		data = device.mapMemory(tmpMemory, 0, indexDataSize);
-		memcpy(data, mIndexData.data(), indexDataSize);
-		device.unmapMemory(tmpMemory);
-		mIndexData.clear();
+private:
+	static bool isSphereVisible(const glm::vec4& sphere, const glm::vec4* frustumPlanes) {
+		for (int i = 0; i < 6; i++) {
+			if (glm::dot(glm::vec3(frustumPlanes[i]), glm::vec3(sphere)) + frustumPlanes[i].w < -sphere.w) return false;
+		}
+		return true;
+	}
 
-		VulkanUtils::copyBuffer(device, pool, queue, tmpBuffer, mIndexBuffer, indexDataSize);
+	void init(const GraphicsVulkan& gfx, GeometryPool& pool, UploadBatcher& batcher, const Geometry& geometry) {
+		mGfx = &gfx;
+		mPool = &pool;
+		mDecode = geometry.decode;
+		mLods.assign(geometry.lods, geometry.lods + geometry.lodCount);
+		mMeshlets.assign(geometry.meshlets, geometry.meshlets + geometry.meshletCount);
+		mBoundingSphere = geometry.boundingSphere;
+		mMaterialIndex = geometry.materialIndex;
+		if (geometry.indexType == vk::IndexType::eUint16 && geometry.vertexCount > 0x10000) throw std::runtime_error("Mesh has too many vertices for 16 bit indices");
+
+		mAllocation = pool.Allocate(batcher, geometry.vertices, geometry.vertexCount, geometry.indices, geometry.indexCount, geometry.indexType);
 	}
 
 private:
-	vk::Buffer mVertexBuffer;
-	vk::Buffer mIndexBuffer;
-
-	vk::DeviceMemory mVertexBufferMemory;
-	vk::DeviceMemory mIndexBufferMemory;
-
-	size_t mIndexCount;
-
-	std::vector<Vertex> mVertexData;
-	std::vector<uint16_t> mIndexData;
+	GeometryPool::Allocation mAllocation;
+	GeometryPool* mPool;
+	VertexFormat::Decode mDecode;
+	std::vector<Lod> mLods;
+	std::vector<Meshlet> mMeshlets;
+	glm::vec4 mBoundingSphere;
+	uint32_t mMaterialIndex;
 
 	const GraphicsVulkan* mGfx;
 
@@ -0,0 +1,159 @@
+#include "MeshCache.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+MeshCache::MeshCache(const std::string& cacheFile, const std::string& sourceFile) {
+	if (mFile.Open(cacheFile)) {
+		mValid = load(sourceFile);
+	}
+	if (!mValid) {
+		//Release the mapping so the cache file can be rewritten
+		mFile.Close();
+		mMeshes.clear();
+		mMaterialTextures.clear();
+	}
+}
+
+bool MeshCache::load(const std::string& sourceFile) {
+	const uint8_t* data = mFile.GetData();
+	size_t size = mFile.GetSize();
+
+	if (size < sizeof(FileHeader)) return false;
+	const FileHeader* header = (const FileHeader*)data;
+	if (header->magic != MAGIC || header->version != VERSION || header->vertexStride != sizeof(VertexFormat::GpuVertex)) return false;
+
+	if (!FileUtils::matchesStamp(sourceFile, header->sourceSize, header->sourceWriteTime, header->sourceHash)) return false;
+
+	size_t tableEnd = sizeof(FileHeader) + sizeof(MeshRecord) * (size_t)header->meshCount;
+	if (size < tableEnd) return false;
+	const MeshRecord* records = (const MeshRecord*)(data + sizeof(FileHeader));
+
+	mMeshes.resize(header->meshCount);
+	for (uint32_t i = 0; i < header->meshCount; i++) {
+		const MeshRecord& record = records[i];
+		if (record.indexSize != sizeof(uint16_t) && record.indexSize != sizeof(uint32_t)) return false;
+		if (record.vertexOffset + (uint64_t)record.vertexCount * sizeof(VertexFormat::GpuVertex) > size) return false;
+		if (record.indexOffset + (uint64_t)record.indexCount * record.indexSize > size) return false;
+		if (record.meshletOffset + (uint64_t)record.meshletCount * sizeof(Mesh::Meshlet) > size) return false;
+		if (record.lodCount == 0 || record.lodCount > Mesh::MAX_LODS) return false;
+		for (uint32_t lod = 0; lod < record.lodCount; lod++) {
+			const Mesh::Lod& level = record.lods[lod];
+			if ((uint64_t)level.firstIndex + level.indexCount > record.indexCount) return false;
+			if ((uint64_t)level.firstMeshlet + level.meshletCount > record.meshletCount) return false;
+		}
+
+		mMeshes[i].vertices = (const VertexFormat::GpuVertex*)(data + record.vertexOffset);
+		mMeshes[i].vertexCount = record.vertexCount;
+		mMeshes[i].indices = data + record.indexOffset;
+		mMeshes[i].indexCount = record.indexCount;
+		mMeshes[i].indexType = record.indexSize == sizeof(uint16_t) ? vk::IndexType::eUint16 : vk::IndexType::eUint32;
+		mMeshes[i].decode = record.decode;
+		mMeshes[i].lods = record.lods;
+		mMeshes[i].lodCount = record.lodCount;
+		mMeshes[i].meshlets = (const Mesh::Meshlet*)(data + record.meshletOffset);
+		mMeshes[i].meshletCount = record.meshletCount;
+		mMeshes[i].boundingSphere = record.boundingSphere;
+		mMeshes[i].materialIndex = record.materialIndex;
+	}
+
+	if (header->materialOffset + (uint64_t)header->materialSize > size) return false;
+	const char* names = (const char*)(data + header->materialOffset);
+	const char* namesEnd = names + header->materialSize;
+	mMaterialTextures.clear();
+	for (uint32_t i = 0; i < header->materialCount; i++) {
+		if (names == namesEnd || (uint8_t)*names > (uint8_t)VulkanImage::Usage::NormalMap) return false;
+		VulkanImage::Usage usage = (VulkanImage::Usage)*names++;
+		const char* end = std::find(names, namesEnd, '\0');
+		if (end == namesEnd) return false;
+		mMaterialTextures.push_back(VulkanImage::Source{ std::string(names, end), usage });
+		names = end + 1;
+	}
+
+	return true;
+}
+
+void MeshCache::Write(const std::string& cacheFile, const std::string& sourceFile, const std::vector<Mesh::Geometry>& meshes, const std::vector<VulkanImage::Source>& materialTextures) {
+	const uint64_t BLOB_ALIGNMENT = 16;
+	auto align = [BLOB_ALIGNMENT](uint64_t offset) { return (offset + BLOB_ALIGNMENT - 1) & ~(BLOB_ALIGNMENT - 1); };
+
+	FileUtils::FileStamp stamp;
+	if (!FileUtils::getFileStamp(sourceFile, stamp)) {
+		std::cout << "Could not stat " << sourceFile << ", mesh cache is not written" << std::endl;
+		return;
+	}
+
+	std::string materialNames;
+	for (const VulkanImage::Source& texture : materialTextures) {
+		materialNames.push_back((char)texture.usage);
+		materialNames.append(texture.filename);
+		materialNames.push_back('\0');
+	}
+
+	FileHeader header{ MAGIC, VERSION, sizeof(VertexFormat::GpuVertex), (uint32_t)meshes.size(), stamp.size, stamp.writeTime, FileUtils::hashFile(sourceFile) };
+	header.materialCount = (uint32_t)materialTextures.size();
+	header.materialSize = (uint32_t)materialNames.size();
+
+	std::vector<MeshRecord> records(meshes.size());
+	uint64_t offset = align(sizeof(FileHeader) + sizeof(MeshRecord) * meshes.size());
+	for (size_t i = 0; i < meshes.size(); i++) {
+		records[i].vertexCount = meshes[i].vertexCount;
+		records[i].indexCount = meshes[i].indexCount;
+		records[i].indexSize = Mesh::GetIndexSize(meshes[i].indexType);
+		records[i].meshletCount = meshes[i].meshletCount;
+		records[i].materialIndex = meshes[i].materialIndex;
+		records[i].lodCount = meshes[i].lodCount;
+		records[i].decode = meshes[i].decode;
+		records[i].boundingSphere = meshes[i].boundingSphere;
+		std::copy(meshes[i].lods, meshes[i].lods + meshes[i].lodCount, records[i].lods);
+		records[i].vertexOffset = offset;
+		offset = align(offset + (uint64_t)meshes[i].vertexCount * sizeof(VertexFormat::GpuVertex));
+		records[i].indexOffset = offset;
+		offset = align(offset + (uint64_t)meshes[i].indexCount * records[i].indexSize);
+		records[i].meshletOffset = offset;
+		offset = align(offset + (uint64_t)meshes[i].meshletCount * sizeof(Mesh::Meshlet));
+	}
+	header.materialOffset = offset;
+
+	//Write next to the target and swap it in afterwards, so an aborted write never leaves a broken cache behind
+	std::string tmpFile = cacheFile + ".tmp";
+	{
+		std::ofstream file(tmpFile, std::ios::binary | std::ios::trunc);
+		if (!file) {
+			std::cout << "Could not open " << tmpFile << " for writing" << std::endl;
+			return;
+		}
+
+		const char padding[BLOB_ALIGNMENT] = {};
+		auto pad = [&file, &padding, &align]() {
+			uint64_t pos = (uint64_t)file.tellp();
+			file.write(padding, align(pos) - pos);
+		};
+
+		file.write((const char*)&header, sizeof(FileHeader));
+		file.write((const char*)records.data(), sizeof(MeshRecord) * records.size());
+		pad();
+		for (const Mesh::Geometry& mesh : meshes) {
+			file.write((const char*)mesh.vertices, sizeof(VertexFormat::GpuVertex) * mesh.vertexCount);
+			pad();
+			file.write((const char*)mesh.indices, (std::streamsize)Mesh::GetIndexSize(mesh.indexType) * mesh.indexCount);
+			pad();
+			file.write((const char*)mesh.meshlets, sizeof(Mesh::Meshlet) * mesh.meshletCount);
+			pad();
+		}
+		file.write(materialNames.data(), materialNames.size());
+		if (!file) {
+			std::cout << "Failed writing mesh cache " << tmpFile << std::endl;
+			return;
+		}
+	}
+
+	std::error_code error;
+	std::filesystem::rename(tmpFile, cacheFile, error);
+	if (error) {
+		std::cout << "Could not replace mesh cache " << cacheFile << ": " << error.message() << std::endl;
+		std::filesystem::remove(tmpFile, error);
+	}
+}
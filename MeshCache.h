@@ -0,0 +1,74 @@
+#pragma once
+
+#include "Mesh.h"
+#include "VulkanImage.h"
+#include "FileUtils.h"
+
+#include <string>
+#include <vector>
+
+/*
+	Cooked binary copy of an imported scene. The file is a header, a table of mesh records and the
+	vertex/index/meshlet blobs in their GPU layout followed by the texture of every material, so loading is a mmap plus a memcpy into staging memory.
+	The cache is bound to its source file by size and write time, with a content hash as fallback.
+*/
+class MeshCache {
+public:
+	MeshCache(const std::string& cacheFile, const std::string& sourceFile);
+	MeshCache(const MeshCache&) = delete;
+	MeshCache& operator=(const MeshCache&) = delete;
+
+	bool IsValid() const {
+		return mValid;
+	}
+	/* Geometry points into the mapped file and stays valid as long as the cache lives */
+	const std::vector<Mesh::Geometry>& GetMeshes() const {
+		return mMeshes;
+	}
+	/* Diffuse texture per material index, empty filename for materials without one */
+	const std::vector<VulkanImage::Source>& GetMaterialTextures() const {
+		return mMaterialTextures;
+	}
+
+	static void Write(const std::string& cacheFile, const std::string& sourceFile, const std::vector<Mesh::Geometry>& meshes, const std::vector<VulkanImage::Source>& materialTextures);
+
+private:
+	static const uint32_t MAGIC = 0x48534D4E; //"NMSH"
+	static const uint32_t VERSION = 9;
+
+	struct FileHeader {
+		uint32_t magic;
+		uint32_t version;
+		uint32_t vertexStride;
+		uint32_t meshCount;
+		uint64_t sourceSize;
+		int64_t sourceWriteTime;
+		uint64_t sourceHash;
+		uint64_t materialOffset; //per material a usage byte and a null terminated texture path
+		uint32_t materialCount;
+		uint32_t materialSize;
+	};
+	struct MeshRecord {
+		uint64_t vertexOffset;
+		uint64_t indexOffset;
+		uint64_t meshletOffset;
+		uint32_t meshletCount;
+		uint32_t materialIndex;
+		uint32_t vertexCount;
+		uint32_t indexCount;
+		uint32_t indexSize;
+		uint32_t lodCount;
+		VertexFormat::Decode decode;
+		glm::vec4 boundingSphere;
+		Mesh::Lod lods[Mesh::MAX_LODS];
+	};
+
+private:
+	bool load(const std::string& sourceFile);
+
+private:
+	FileUtils::MappedFile mFile;
+	std::vector<Mesh::Geometry> mMeshes;
+	std::vector<VulkanImage::Source> mMaterialTextures;
+	bool mValid = false;
+};
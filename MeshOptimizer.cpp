@@ -0,0 +1,584 @@
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+namespace MeshOptimizer {
+
+	namespace {
+		struct Adjacency {
+			std::vector<uint32_t> offsets; //per vertex start into triangles, vertexCount + 1 entries
+			std::vector<uint32_t> triangles;
+		};
+
+		void buildAdjacency(Adjacency& adjacency, const uint32_t* indices, size_t indexCount, size_t vertexCount) {
+			adjacency.offsets.assign(vertexCount + 1, 0);
+			for (size_t i = 0; i < indexCount; i++) adjacency.offsets[indices[i] + 1]++;
+			for (size_t v = 0; v < vertexCount; v++) adjacency.offsets[v + 1] += adjacency.offsets[v];
+
+			std::vector<uint32_t> cursor(adjacency.offsets.begin(), adjacency.offsets.end() - 1);
+			adjacency.triangles.resize(indexCount);
+			for (size_t i = 0; i < indexCount; i++) {
+				adjacency.triangles[cursor[indices[i]]++] = (uint32_t)(i / 3);
+			}
+		}
+
+		//Fresh FIFO cache simulation over a range of triangles, returns the number of misses
+		class FifoCache {
+		public:
+			FifoCache(size_t vertexCount, uint32_t cacheSize) :
+				mTimestamps(vertexCount, 0), mCacheSize(cacheSize) {}
+
+			void Reset() {
+				//Pushing the time forward invalidates every vertex at once
+				mTime += mCacheSize + 1;
+			}
+			uint32_t Access(const uint32_t* triangle) {
+				uint32_t misses = 0;
+				for (int k = 0; k < 3; k++) {
+					uint32_t v = triangle[k];
+					if (mTime - mTimestamps[v] > mCacheSize) {
+						mTimestamps[v] = mTime++;
+						misses++;
+					}
+				}
+				return misses;
+			}
+
+		private:
+			std::vector<uint32_t> mTimestamps;
+			uint32_t mCacheSize;
+			uint32_t mTime = 0;
+		};
+	}
+
+	CacheStats analyzeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize) {
+		CacheStats stats{ 0.0f, 0.0f };
+		if (indexCount == 0 || vertexCount == 0) return stats;
+
+		FifoCache cache(vertexCount, cacheSize);
+		cache.Reset();
+		size_t misses = 0;
+		for (size_t i = 0; i < indexCount; i += 3) misses += cache.Access(&indices[i]);
+
+		std::vector<bool> used(vertexCount, false);
+		size_t usedVertices = 0;
+		for (size_t i = 0; i < indexCount; i++) {
+			if (!used[indices[i]]) {
+				used[indices[i]] = true;
+				usedVertices++;
+			}
+		}
+
+		stats.acmr = (float)misses / (float)(indexCount / 3);
+		stats.atvr = (float)misses / (float)usedVertices;
+		return stats;
+	}
+
+	void optimizeVertexCache(uint32_t* destination, const uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize, std::vector<uint32_t>& outClusters) {
+		outClusters.clear();
+		if (indexCount == 0) return;
+
+		std::vector<uint32_t> input(indices, indices + indexCount); //destination may alias indices
+		size_t triangleCount = indexCount / 3;
+
+		Adjacency adjacency;
+		buildAdjacency(adjacency, input.data(), indexCount, vertexCount);
+
+		std::vector<uint32_t> liveTriangles(vertexCount);
+		for (size_t v = 0; v < vertexCount; v++) liveTriangles[v] = adjacency.offsets[v + 1] - adjacency.offsets[v];
+
+		std::vector<uint32_t> timestamps(vertexCount, 0);
+		std::vector<bool> emitted(triangleCount, false);
+		std::vector<uint32_t> deadEnd;
+		deadEnd.reserve(indexCount);
+		std::vector<uint32_t> candidates;
+
+		uint32_t time = cacheSize + 1;
+		size_t scanCursor = 0;
+		size_t outputCursor = 0;
+		int64_t fanVertex = 0;
+		bool newCluster = true;
+
+		//Start with the first used vertex
+		while (fanVertex < (int64_t)vertexCount && liveTriangles[fanVertex] == 0) fanVertex++;
+
+		while (fanVertex >= 0 && fanVertex < (int64_t)vertexCount) {
+			if (newCluster) {
+				outClusters.push_back((uint32_t)outputCursor);
+				newCluster = false;
+			}
+
+			candidates.clear();
+			for (uint32_t a = adjacency.offsets[fanVertex]; a < adjacency.offsets[fanVertex + 1]; a++) {
+				uint32_t triangle = adjacency.triangles[a];
+				if (emitted[triangle]) continue;
+
+				for (int k = 0; k < 3; k++) {
+					uint32_t v = input[triangle * 3 + k];
+					destination[outputCursor++] = v;
+					deadEnd.push_back(v);
+					candidates.push_back(v);
+					liveTriangles[v]--;
+					if (time - timestamps[v] > cacheSize) timestamps[v] = time++;
+				}
+				emitted[triangle] = true;
+			}
+
+			//Next fanning vertex: the youngest candidate that stays in cache while its remaining fan is emitted
+			int64_t best = -1;
+			uint32_t bestPriority = 0;
+			for (uint32_t v : candidates) {
+				if (liveTriangles[v] == 0) continue;
+				uint32_t priority = 0;
+				if (time - timestamps[v] + 2 * liveTriangles[v] <= cacheSize) priority = time - timestamps[v];
+				if (best == -1 || priority > bestPriority) {
+					best = v;
+					bestPriority = priority;
+				}
+			}
+
+			if (best == -1) {
+				//Dead end, continue with a recently touched vertex or the next unfinished one in input order
+				newCluster = true;
+				while (!deadEnd.empty()) {
+					uint32_t v = deadEnd.back();
+					deadEnd.pop_back();
+					if (liveTriangles[v] > 0) {
+						best = v;
+						break;
+					}
+				}
+				if (best == -1) {
+					while (scanCursor < vertexCount && liveTriangles[scanCursor] == 0) scanCursor++;
+					best = scanCursor < vertexCount ? (int64_t)scanCursor : -1;
+				}
+			}
+			fanVertex = best;
+		}
+	}
+
+	void optimizeOverdraw(uint32_t* destination, const uint32_t* indices, size_t indexCount, const float* positions, size_t positionStride, size_t vertexCount,
+		const std::vector<uint32_t>& clusters, uint32_t cacheSize, float threshold) {
+		if (indexCount == 0) return;
+
+		std::vector<uint32_t> input(indices, indices + indexCount);
+		auto position = [positions, positionStride](uint32_t v) {
+			return (const float*)((const uint8_t*)positions + positionStride * v);
+		};
+
+		//Soft boundaries: cut a hard cluster wherever its running ACMR already reached the cluster's target
+		std::vector<uint32_t> softClusters;
+		FifoCache cache(vertexCount, cacheSize);
+		for (size_t c = 0; c < clusters.size(); c++) {
+			size_t start = clusters[c];
+			size_t end = c + 1 < clusters.size() ? clusters[c + 1] : indexCount;
+
+			cache.Reset();
+			uint32_t clusterMisses = 0;
+			for (size_t i = start; i < end; i += 3) clusterMisses += cache.Access(&input[i]);
+			float clusterThreshold = threshold * (float)clusterMisses / (float)((end - start) / 3);
+
+			softClusters.push_back((uint32_t)start);
+			cache.Reset();
+			uint32_t runningMisses = 0;
+			uint32_t runningTriangles = 0;
+			for (size_t i = start; i < end; i += 3) {
+				runningMisses += cache.Access(&input[i]);
+				runningTriangles++;
+				if ((float)runningMisses / (float)runningTriangles <= clusterThreshold && i + 3 < end) {
+					softClusters.push_back((uint32_t)(i + 3));
+					cache.Reset();
+					runningMisses = 0;
+					runningTriangles = 0;
+				}
+			}
+		}
+
+		//Area weighted centroid and average normal of every cluster
+		struct ClusterSort {
+			uint32_t start;
+			uint32_t end;
+			float centroid[3];
+			float normal[3];
+			float key;
+		};
+		std::vector<ClusterSort> sortData(softClusters.size());
+		float meshCentroid[3] = { 0.0f, 0.0f, 0.0f };
+		float meshArea = 0.0f;
+
+		for (size_t c = 0; c < softClusters.size(); c++) {
+			ClusterSort& cluster = sortData[c];
+			cluster.start = softClusters[c];
+			cluster.end = c + 1 < softClusters.size() ? softClusters[c + 1] : (uint32_t)indexCount;
+
+			float centroid[3] = { 0.0f, 0.0f, 0.0f };
+			float normal[3] = { 0.0f, 0.0f, 0.0f };
+			float area = 0.0f;
+			for (size_t i = cluster.start; i < cluster.end; i += 3) {
+				const float* p0 = position(input[i + 0]);
+				const float* p1 = position(input[i + 1]);
+				const float* p2 = position(input[i + 2]);
+				float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+				float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+				float n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+				float triangleArea = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+
+				for (int k = 0; k < 3; k++) {
+					centroid[k] += (p0[k] + p1[k] + p2[k]) * (triangleArea / 3.0f);
+					normal[k] += n[k];
+				}
+				area += triangleArea;
+			}
+
+			for (int k = 0; k < 3; k++) meshCentroid[k] += centroid[k];
+			meshArea += area;
+
+			float invArea = area == 0.0f ? 0.0f : 1.0f / area;
+			float normalLength = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+			float invNormalLength = normalLength == 0.0f ? 0.0f : 1.0f / normalLength;
+			for (int k = 0; k < 3; k++) {
+				cluster.centroid[k] = centroid[k] * invArea;
+				cluster.normal[k] = normal[k] * invNormalLength;
+			}
+		}
+
+		float invMeshArea = meshArea == 0.0f ? 0.0f : 1.0f / meshArea;
+		for (int k = 0; k < 3; k++) meshCentroid[k] *= invMeshArea;
+
+		//Clusters facing away from the mesh center are likely occluders, so they go first
+		for (ClusterSort& cluster : sortData) {
+			cluster.key = 0.0f;
+			for (int k = 0; k < 3; k++) cluster.key += (cluster.centroid[k] - meshCentroid[k]) * cluster.normal[k];
+		}
+		std::stable_sort(sortData.begin(), sortData.end(), [](const ClusterSort& a, const ClusterSort& b) { return a.key > b.key; });
+
+		size_t outputCursor = 0;
+		for (const ClusterSort& cluster : sortData) {
+			for (uint32_t i = cluster.start; i < cluster.end; i++) destination[outputCursor++] = input[i];
+		}
+	}
+
+	size_t optimizeVertexFetchRemap(uint32_t* indices, size_t indexCount, size_t vertexCount, std::vector<uint32_t>& outRemap) {
+		outRemap.assign(vertexCount, UINT32_MAX);
+		uint32_t nextVertex = 0;
+		for (size_t i = 0; i < indexCount; i++) {
+			uint32_t& remapped = outRemap[indices[i]];
+			if (remapped == UINT32_MAX) remapped = nextVertex++;
+			indices[i] = remapped;
+		}
+		return nextVertex;
+	}
+
+	namespace {
+		//Symmetric 4x4 error quadric, error(p) = p^T A p + 2 b.p + c
+		/* Sum of area weighted plane quadrics, the error is the weighted mean of the squared plane distances */
+		struct Quadric {
+			float a00, a11, a22, a01, a02, a12;
+			float b0, b1, b2;
+			float c;
+			float weight;
+
+			void Add(const Quadric& other) {
+				a00 += other.a00; a11 += other.a11; a22 += other.a22;
+				a01 += other.a01; a02 += other.a02; a12 += other.a12;
+				b0 += other.b0; b1 += other.b1; b2 += other.b2;
+				c += other.c;
+				weight += other.weight;
+			}
+			float Error(const float* p) const {
+				float x = p[0], y = p[1], z = p[2];
+				float result = a00 * x * x + a11 * y * y + a22 * z * z
+					+ 2.0f * (a01 * x * y + a02 * x * z + a12 * y * z)
+					+ 2.0f * (b0 * x + b1 * y + b2 * z) + c;
+				//Normalized, so the error stays a squared world space distance no matter how big the triangles are
+				return result > 0.0f && weight > 0.0f ? result / weight : 0.0f;
+			}
+			static Quadric FromPlane(float nx, float ny, float nz, float d, float weight) {
+				return Quadric{ nx * nx * weight, ny * ny * weight, nz * nz * weight,
+					nx * ny * weight, nx * nz * weight, ny * nz * weight,
+					nx * d * weight, ny * d * weight, nz * d * weight,
+					d * d * weight, weight };
+			}
+		};
+
+		void triangleNormal(const float* p0, const float* p1, const float* p2, float* outNormal) {
+			float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+			float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+			outNormal[0] = e1[1] * e2[2] - e1[2] * e2[1];
+			outNormal[1] = e1[2] * e2[0] - e1[0] * e2[2];
+			outNormal[2] = e1[0] * e2[1] - e1[1] * e2[0];
+		}
+
+		struct Collapse {
+			uint32_t from;
+			uint32_t to;
+			float error;
+		};
+	}
+
+	size_t simplify(uint32_t* destination, const uint32_t* indices, size_t indexCount, const float* positions, size_t positionStride, size_t vertexCount,
+		size_t targetIndexCount, float maxError, float* outError) {
+		auto position = [positions, positionStride](uint32_t v) {
+			return (const float*)((const uint8_t*)positions + positionStride * v);
+		};
+
+		std::vector<uint32_t> result(indices, indices + indexCount);
+		float resultError = 0.0f;
+
+		//Vertices sharing a position with another vertex sit on a UV seam
+		std::vector<bool> locked(vertexCount, false);
+		{
+			std::vector<uint32_t> order(vertexCount);
+			for (uint32_t v = 0; v < vertexCount; v++) order[v] = v;
+			auto less = [&position](uint32_t a, uint32_t b) {
+				return std::lexicographical_compare(position(a), position(a) + 3, position(b), position(b) + 3);
+			};
+			std::sort(order.begin(), order.end(), less);
+			for (size_t i = 1; i < order.size(); i++) {
+				if (!less(order[i - 1], order[i])) {
+					locked[order[i - 1]] = true;
+					locked[order[i]] = true;
+				}
+			}
+		}
+
+		//Open edges are only used by one triangle in one direction
+		{
+			std::vector<std::pair<uint32_t, uint32_t>> edges;
+			edges.reserve(indexCount);
+			for (size_t i = 0; i < indexCount; i += 3) {
+				for (int k = 0; k < 3; k++) {
+					uint32_t a = indices[i + k];
+					uint32_t b = indices[i + (k + 1) % 3];
+					edges.push_back({ a, b });
+				}
+			}
+			std::sort(edges.begin(), edges.end());
+			for (const auto& edge : edges) {
+				if (!std::binary_search(edges.begin(), edges.end(), std::make_pair(edge.second, edge.first))) {
+					locked[edge.first] = true;
+					locked[edge.second] = true;
+				}
+			}
+		}
+
+		std::vector<Quadric> quadrics(vertexCount, Quadric{});
+		for (size_t i = 0; i < indexCount; i += 3) {
+			const float* p0 = position(indices[i + 0]);
+			float n[3];
+			triangleNormal(p0, position(indices[i + 1]), position(indices[i + 2]), n);
+			float length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+			if (length == 0.0f) continue;
+
+			float area = length * 0.5f;
+			n[0] /= length; n[1] /= length; n[2] /= length;
+			float d = -(n[0] * p0[0] + n[1] * p0[1] + n[2] * p0[2]);
+			Quadric q = Quadric::FromPlane(n[0], n[1], n[2], d, area);
+			for (int k = 0; k < 3; k++) quadrics[indices[i + k]].Add(q);
+		}
+
+		float maxErrorSquared = maxError * maxError;
+		std::vector<uint32_t> remap(vertexCount);
+		std::vector<bool> touched(vertexCount);
+		std::vector<Collapse> collapses;
+		Adjacency adjacency;
+
+		while (result.size() > targetIndexCount) {
+			buildAdjacency(adjacency, result.data(), result.size(), vertexCount);
+
+			//Every edge gives a candidate per movable endpoint
+			collapses.clear();
+			for (size_t i = 0; i < result.size(); i += 3) {
+				for (int k = 0; k < 3; k++) {
+					uint32_t a = result[i + k];
+					uint32_t b = result[i + (k + 1) % 3];
+					if (!locked[a]) {
+						Quadric q = quadrics[a];
+						q.Add(quadrics[b]);
+						collapses.push_back({ a, b, q.Error(position(b)) });
+					}
+					if (!locked[b]) {
+						Quadric q = quadrics[b];
+						q.Add(quadrics[a]);
+						collapses.push_back({ b, a, q.Error(position(a)) });
+					}
+				}
+			}
+			if (collapses.empty()) break;
+			std::sort(collapses.begin(), collapses.end(), [](const Collapse& x, const Collapse& y) { return x.error < y.error; });
+
+			for (uint32_t v = 0; v < vertexCount; v++) remap[v] = v;
+			std::fill(touched.begin(), touched.end(), false);
+
+			//A collapse removes about two triangles, don't overshoot the target by much in one pass
+			size_t collapseBudget = (result.size() - targetIndexCount) / 6 + 1;
+			size_t collapseCount = 0;
+			bool reachedErrorLimit = false;
+
+			for (const Collapse& collapse : collapses) {
+				if (collapseCount >= collapseBudget) break;
+				if (collapse.error > maxErrorSquared) {
+					reachedErrorLimit = true;
+					break;
+				}
+				if (touched[collapse.from] || touched[collapse.to]) continue;
+
+				//Reject collapses that flip a triangle of the moving vertex' fan
+				const float* target = position(collapse.to);
+				bool flips = false;
+				for (uint32_t a = adjacency.offsets[collapse.from]; a < adjacency.offsets[collapse.from + 1] && !flips; a++) {
+					const uint32_t* triangle = &result[adjacency.triangles[a] * 3];
+					if (triangle[0] == collapse.to || triangle[1] == collapse.to || triangle[2] == collapse.to) continue;
+
+					const float* before[3];
+					const float* after[3];
+					for (int k = 0; k < 3; k++) {
+						before[k] = position(triangle[k]);
+						after[k] = triangle[k] == collapse.from ? target : before[k];
+					}
+					float nBefore[3];
+					float nAfter[3];
+					triangleNormal(before[0], before[1], before[2], nBefore);
+					triangleNormal(after[0], after[1], after[2], nAfter);
+					flips = nBefore[0] * nAfter[0] + nBefore[1] * nAfter[1] + nBefore[2] * nAfter[2] <= 0.0f;
+				}
+				if (flips) continue;
+
+				//Lock the whole fan, so collapses within one pass never see each others stale triangles
+				for (uint32_t a = adjacency.offsets[collapse.from]; a < adjacency.offsets[collapse.from + 1]; a++) {
+					const uint32_t* triangle = &result[adjacency.triangles[a] * 3];
+					touched[triangle[0]] = true;
+					touched[triangle[1]] = true;
+					touched[triangle[2]] = true;
+				}
+
+				remap[collapse.from] = collapse.to;
+				quadrics[collapse.to].Add(quadrics[collapse.from]);
+				resultError = std::max(resultError, collapse.error);
+				collapseCount++;
+			}
+
+			if (collapseCount == 0) break;
+
+			size_t writeCursor = 0;
+			for (size_t i = 0; i < result.size(); i += 3) {
+				uint32_t a = remap[result[i + 0]];
+				uint32_t b = remap[result[i + 1]];
+				uint32_t c = remap[result[i + 2]];
+				if (a == b || b == c || a == c) continue;
+				result[writeCursor++] = a;
+				result[writeCursor++] = b;
+				result[writeCursor++] = c;
+			}
+			result.resize(writeCursor);
+
+			if (reachedErrorLimit) break;
+		}
+
+		std::copy(result.begin(), result.end(), destination);
+		if (outError) *outError = std::sqrt(resultError);
+		return result.size();
+	}
+
+	void buildMeshlets(const uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t maxVertices, uint32_t maxTriangles, std::vector<Meshlet>& outMeshlets) {
+		//Last meshlet a vertex was counted for, avoids clearing a set per meshlet
+		std::vector<uint32_t> seenIn(vertexCount, UINT32_MAX);
+		uint32_t meshletId = (uint32_t)outMeshlets.size();
+
+		Meshlet current{ 0, 0 };
+		uint32_t currentVertices = 0;
+		for (size_t i = 0; i < indexCount; i += 3) {
+			uint32_t newVertices = 0;
+			for (int k = 0; k < 3; k++) {
+				if (seenIn[indices[i + k]] != meshletId) newVertices++;
+			}
+			//Duplicate indices in a degenerate triangle can only over count, which is harmless
+			if (currentVertices + newVertices > maxVertices || current.indexCount / 3 + 1 > maxTriangles) {
+				outMeshlets.push_back(current);
+				meshletId++;
+				current = Meshlet{ (uint32_t)i, 0 };
+				currentVertices = 0;
+			}
+
+			for (int k = 0; k < 3; k++) {
+				if (seenIn[indices[i + k]] != meshletId) {
+					seenIn[indices[i + k]] = meshletId;
+					currentVertices++;
+				}
+			}
+			current.indexCount += 3;
+		}
+		if (current.indexCount > 0) outMeshlets.push_back(current);
+	}
+
+	MeshletBounds computeMeshletBounds(const uint32_t* indices, size_t indexCount, const float* positions, size_t positionStride, bool flipNormals) {
+		//Below this the cone is so wide that it hardly ever rejects anything
+		const float MIN_CONE_DOT = 0.1f;
+		auto position = [positions, positionStride](uint32_t v) { return (const float*)((const uint8_t*)positions + v * positionStride); };
+
+		MeshletBounds bounds{};
+		if (indexCount == 0) {
+			bounds.coneCutoff = 1.0f;
+			return bounds;
+		}
+
+		float boundsMin[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+		float boundsMax[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+		for (size_t i = 0; i < indexCount; i++) {
+			const float* p = position(indices[i]);
+			for (int k = 0; k < 3; k++) {
+				boundsMin[k] = std::min(boundsMin[k], p[k]);
+				boundsMax[k] = std::max(boundsMax[k], p[k]);
+			}
+		}
+		for (int k = 0; k < 3; k++) bounds.center[k] = (boundsMin[k] + boundsMax[k]) * 0.5f;
+
+		float radiusSq = 0.0f;
+		for (size_t i = 0; i < indexCount; i++) {
+			const float* p = position(indices[i]);
+			float d[3] = { p[0] - bounds.center[0], p[1] - bounds.center[1], p[2] - bounds.center[2] };
+			radiusSq = std::max(radiusSq, d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+		}
+		bounds.radius = std::sqrt(radiusSq);
+
+		//Cone axis is the mean unit normal, its spread is the widest angle to any triangle normal
+		std::vector<float> normals;
+		normals.reserve(indexCount);
+		float axis[3] = { 0.0f, 0.0f, 0.0f };
+		for (size_t i = 0; i < indexCount; i += 3) {
+			float n[3];
+			triangleNormal(position(indices[i]), position(indices[i + 1]), position(indices[i + 2]), n);
+			float length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+			if (length == 0.0f) continue;
+			if (flipNormals) length = -length;
+
+			for (int k = 0; k < 3; k++) {
+				n[k] /= length;
+				axis[k] += n[k];
+				normals.push_back(n[k]);
+			}
+		}
+
+		float axisLength = std::sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+		float minDot = 1.0f;
+		if (axisLength > 0.0f) {
+			for (int k = 0; k < 3; k++) axis[k] /= axisLength;
+			for (size_t i = 0; i < normals.size(); i += 3) {
+				minDot = std::min(minDot, axis[0] * normals[i] + axis[1] * normals[i + 1] + axis[2] * normals[i + 2]);
+			}
+		}
+
+		std::copy(axis, axis + 3, bounds.coneAxis);
+		if (axisLength == 0.0f || minDot < MIN_CONE_DOT) {
+			bounds.coneCutoff = 1.0f;
+		} else {
+			//sin of the cone half angle, the cluster is back facing from inside the complementary cone
+			bounds.coneCutoff = std::sqrt(1.0f - minDot * minDot);
+		}
+		return bounds;
+	}
+
+}
\ No newline at end of file
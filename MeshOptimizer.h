@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+/*
+	Import time triangle and vertex reordering, all functions work on 32 bit triangle lists.
+	Positions are read as three floats at the given byte stride.
+*/
+namespace MeshOptimizer {
+
+	//Post transform cache size the orderings are tuned for and analyzed with
+	const uint32_t CACHE_SIZE = 16;
+
+	struct CacheStats {
+		float acmr; //cache misses per triangle, 0.5 is ideal for regular grids, 3 is worst
+		float atvr; //cache misses per vertex, 1 is ideal
+	};
+
+	/* Simulates a FIFO post transform cache */
+	CacheStats analyzeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize = CACHE_SIZE);
+
+	/*
+		Tipsify (Sander et al. 2007) triangle order for vertex cache locality.
+		outClusters receives the first index of every run that started after a dead end, those are the
+		hard boundaries optimizeOverdraw is allowed to reorder at.
+	*/
+	void optimizeVertexCache(uint32_t* destination, const uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize, std::vector<uint32_t>& outClusters);
+
+	/*
+		Splits the cache optimized clusters further while the ACMR stays within threshold of the
+		cluster's own ACMR, then sorts the clusters so outward facing ones are drawn first.
+	*/
+	void optimizeOverdraw(uint32_t* destination, const uint32_t* indices, size_t indexCount, const float* positions, size_t positionStride, size_t vertexCount,
+		const std::vector<uint32_t>& clusters, uint32_t cacheSize, float threshold);
+
+	/*
+		Renumbers vertices in order of first use for fetch locality. Indices are rewritten in place,
+		outRemap[oldIndex] gives the new index, unused vertices get UINT32_MAX. Returns the used vertex count.
+	*/
+	size_t optimizeVertexFetchRemap(uint32_t* indices, size_t indexCount, size_t vertexCount, std::vector<uint32_t>& outRemap);
+
+	/*
+		Quadric error edge collapse simplification towards targetIndexCount (Garland & Heckbert, half edge collapses).
+		Vertices on open borders and UV seams (several vertices sharing a position) are never moved, so seams
+		stay intact; they can still be collapse targets. Stops early when the next collapse would exceed maxError.
+		Returns the new index count, outError receives the largest collapse error as a distance in position units.
+	*/
+	size_t simplify(uint32_t* destination, const uint32_t* indices, size_t indexCount, const float* positions, size_t positionStride, size_t vertexCount,
+		size_t targetIndexCount, float maxError, float* outError);
+
+	//Cluster limits, sized so a cluster fits a typical mesh shader workgroup later on
+	const uint32_t MESHLET_MAX_VERTICES = 64;
+	const uint32_t MESHLET_MAX_TRIANGLES = 124;
+
+	/* Contiguous range of the index list */
+	struct Meshlet {
+		uint32_t firstIndex;
+		uint32_t indexCount;
+	};
+
+	/*
+		Bounding sphere and normal cone of a meshlet. The meshlet faces away from a viewer at position p if
+		dot(center - p, coneAxis) >= coneCutoff * length(center - p) + radius. Cutoff 1 disables the test.
+	*/
+	struct MeshletBounds {
+		float center[3];
+		float radius;
+		float coneAxis[3];
+		float coneCutoff;
+	};
+
+	/*
+		Greedily splits the index list into meshlets in triangle order, so every meshlet stays a contiguous
+		index range and can be drawn with a plain indexed draw. Works best on cache optimized triangle orders.
+	*/
+	void buildMeshlets(const uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t maxVertices, uint32_t maxTriangles, std::vector<Meshlet>& outMeshlets);
+
+	/*
+		Triangle normals are cross(p1 - p0, p2 - p0). flipNormals is for pipelines whose front faces are the triangles
+		with that normal pointing away from the viewer, so the cone still describes the side that gets drawn.
+	*/
+	MeshletBounds computeMeshletBounds(const uint32_t* indices, size_t indexCount, const float* positions, size_t positionStride, bool flipNormals);
+
+	/* Applies a remap from optimizeVertexFetchRemap to a vertex array */
+	template<typename T>
+	void remapVertices(std::vector<T>& vertices, const std::vector<uint32_t>& remap, size_t newVertexCount) {
+		std::vector<T> result(newVertexCount);
+		for (size_t i = 0; i < vertices.size(); i++) {
+			if (remap[i] != UINT32_MAX) result[remap[i]] = vertices[i];
+		}
+		vertices.swap(result);
+	}
+
+}
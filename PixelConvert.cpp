@@ -0,0 +1,350 @@
+#include "PixelConvert.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <random>
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define NOU_PIXEL_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+//MSVC emits any intrinsic without flags, the runtime check keeps them off CPUs that lack them
+#define NOU_TARGET(isa)
+#else
+#define NOU_TARGET(isa) __attribute__((target(isa)))
+#endif
+#endif
+
+namespace PixelConvert {
+
+	namespace {
+		//Linear values are quantized to 12 bit before the lookup, close enough for 8 bit sRGB
+		const uint32_t LINEAR_STEPS = 4096;
+
+		struct Tables {
+			float srgbToLinear[256];
+			uint32_t linearToSrgb[LINEAR_STEPS]; //32 bit entries, so AVX2 can gather them
+
+			Tables() {
+				for (uint32_t i = 0; i < 256; i++) {
+					float c = i / 255.0f;
+					srgbToLinear[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+				}
+				for (uint32_t i = 0; i < LINEAR_STEPS; i++) {
+					float l = i / (float)(LINEAR_STEPS - 1);
+					float c = l <= 0.0031308f ? l * 12.92f : 1.055f * std::pow(l, 1.0f / 2.4f) - 0.055f;
+					linearToSrgb[i] = (uint32_t)std::lround(c * 255.0f);
+				}
+			}
+		};
+		const Tables& getTables() {
+			static const Tables tables;
+			return tables;
+		}
+
+		const float INV_255 = 1.0f / 255.0f;
+
+		Isa detectIsa() {
+#ifdef NOU_PIXEL_X86
+#ifdef _MSC_VER
+			int info[4];
+			__cpuid(info, 1);
+			bool ssse3 = (info[2] & (1 << 9)) != 0;
+			bool osAvx = (info[2] & (1 << 27)) != 0 && (info[2] & (1 << 28)) != 0 && (_xgetbv(0) & 6) == 6;
+			__cpuidex(info, 7, 0);
+			bool avx2 = osAvx && (info[1] & (1 << 5)) != 0;
+#else
+			bool ssse3 = __builtin_cpu_supports("ssse3");
+			bool avx2 = __builtin_cpu_supports("avx2");
+#endif
+			if (avx2) return Isa::AVX2;
+			if (ssse3) return Isa::SSSE3;
+#endif
+			return Isa::Scalar;
+		}
+
+		const Isa SUPPORTED_ISA = detectIsa();
+		std::atomic<Isa> sMaxIsa{ Isa::AVX2 };
+		//The benchmark caps only its own thread, loader threads keep converting at full speed meanwhile
+		thread_local Isa tBenchmarkIsa = Isa::AVX2;
+
+		//Scalar versions, they also finish the tails of the SIMD loops
+
+		void expandScalar(const uint8_t* rgb, uint8_t* rgba, size_t begin, size_t count) {
+			for (size_t i = begin; i < count; i++) {
+				rgba[i * 4 + 0] = rgb[i * 3 + 0];
+				rgba[i * 4 + 1] = rgb[i * 3 + 1];
+				rgba[i * 4 + 2] = rgb[i * 3 + 2];
+				rgba[i * 4 + 3] = 255;
+			}
+		}
+
+		void packScalar(const uint8_t* rgba, uint8_t* rg, size_t begin, size_t count) {
+			for (size_t i = begin; i < count; i++) {
+				rg[i * 2 + 0] = rgba[i * 4 + 0];
+				rg[i * 2 + 1] = rgba[i * 4 + 1];
+			}
+		}
+
+		void srgbToLinearScalar(const uint8_t* rgba, float* linear, size_t begin, size_t count) {
+			const Tables& tables = getTables();
+			for (size_t i = begin * 4; i < count * 4; i += 4) {
+				linear[i + 0] = tables.srgbToLinear[rgba[i + 0]];
+				linear[i + 1] = tables.srgbToLinear[rgba[i + 1]];
+				linear[i + 2] = tables.srgbToLinear[rgba[i + 2]];
+				linear[i + 3] = (float)rgba[i + 3] * INV_255;
+			}
+		}
+
+		float clampUnit(float v) {
+			//NaN ends up as 0, like the SIMD max/min order below
+			v = v > 0.0f ? v : 0.0f;
+			return v < 1.0f ? v : 1.0f;
+		}
+
+		void linearToSrgbScalar(const float* linear, uint8_t* rgba, size_t begin, size_t count) {
+			const Tables& tables = getTables();
+			for (size_t i = begin * 4; i < count * 4; i += 4) {
+				for (uint32_t c = 0; c < 3; c++) {
+					rgba[i + c] = (uint8_t)tables.linearToSrgb[(uint32_t)std::nearbyint(clampUnit(linear[i + c]) * (float)(LINEAR_STEPS - 1))];
+				}
+				rgba[i + 3] = (uint8_t)std::nearbyint(clampUnit(linear[i + 3]) * 255.0f);
+			}
+		}
+
+#ifdef NOU_PIXEL_X86
+		//Picks the 3 bytes of each of 4 pixels into the low bytes of 4 dwords
+		#define NOU_RGB_TO_RGBA_SHUFFLE 0, 1, 2, (char)0x80, 3, 4, 5, (char)0x80, 6, 7, 8, (char)0x80, 9, 10, 11, (char)0x80
+		//Red and green of 4 pixels into the low 8 bytes
+		#define NOU_RGBA_TO_RG_SHUFFLE 0, 1, 4, 5, 8, 9, 12, 13, (char)0x80, (char)0x80, (char)0x80, (char)0x80, (char)0x80, (char)0x80, (char)0x80, (char)0x80
+
+		NOU_TARGET("ssse3") void expandSSSE3(const uint8_t* rgb, uint8_t* rgba, size_t count) {
+			const __m128i shuffle = _mm_setr_epi8(NOU_RGB_TO_RGBA_SHUFFLE);
+			const __m128i alpha = _mm_set1_epi32((int)0xFF000000);
+			size_t i = 0;
+			for (; i + 16 <= count; i += 16) {
+				__m128i a = _mm_loadu_si128((const __m128i*)&rgb[i * 3]);
+				__m128i b = _mm_loadu_si128((const __m128i*)&rgb[i * 3 + 16]);
+				__m128i c = _mm_loadu_si128((const __m128i*)&rgb[i * 3 + 32]);
+				_mm_storeu_si128((__m128i*)&rgba[i * 4], _mm_or_si128(_mm_shuffle_epi8(a, shuffle), alpha));
+				_mm_storeu_si128((__m128i*)&rgba[i * 4 + 16], _mm_or_si128(_mm_shuffle_epi8(_mm_alignr_epi8(b, a, 12), shuffle), alpha));
+				_mm_storeu_si128((__m128i*)&rgba[i * 4 + 32], _mm_or_si128(_mm_shuffle_epi8(_mm_alignr_epi8(c, b, 8), shuffle), alpha));
+				_mm_storeu_si128((__m128i*)&rgba[i * 4 + 48], _mm_or_si128(_mm_shuffle_epi8(_mm_srli_si128(c, 4), shuffle), alpha));
+			}
+			expandScalar(rgb, rgba, i, count);
+		}
+
+		NOU_TARGET("avx2") void expandAVX2(const uint8_t* rgb, uint8_t* rgba, size_t count) {
+			//Moves pixels 4 to 7 into the upper lane, the byte shuffle only works within lanes
+			const __m256i spread = _mm256_setr_epi32(0, 1, 2, 0, 3, 4, 5, 0);
+			const __m256i shuffle = _mm256_setr_epi8(NOU_RGB_TO_RGBA_SHUFFLE, NOU_RGB_TO_RGBA_SHUFFLE);
+			const __m256i alpha = _mm256_set1_epi32((int)0xFF000000);
+			size_t i = 0;
+			//Every load reads 32 bytes for 8 pixels, so the last 8 bytes must still be inside the source
+			for (; i + 11 <= count; i += 8) {
+				__m256i pixels = _mm256_permutevar8x32_epi32(_mm256_loadu_si256((const __m256i*)&rgb[i * 3]), spread);
+				_mm256_storeu_si256((__m256i*)&rgba[i * 4], _mm256_or_si256(_mm256_shuffle_epi8(pixels, shuffle), alpha));
+			}
+			expandScalar(rgb, rgba, i, count);
+		}
+
+		//Both loads of an iteration come before its store, so packing in place never overwrites unread pixels
+		NOU_TARGET("ssse3") void packSSSE3(const uint8_t* rgba, uint8_t* rg, size_t count) {
+			const __m128i shuffle = _mm_setr_epi8(NOU_RGBA_TO_RG_SHUFFLE);
+			size_t i = 0;
+			for (; i + 8 <= count; i += 8) {
+				__m128i a = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)&rgba[i * 4]), shuffle);
+				__m128i b = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)&rgba[i * 4 + 16]), shuffle);
+				_mm_storeu_si128((__m128i*)&rg[i * 2], _mm_unpacklo_epi64(a, b));
+			}
+			packScalar(rgba, rg, i, count);
+		}
+
+		NOU_TARGET("avx2") void packAVX2(const uint8_t* rgba, uint8_t* rg, size_t count) {
+			const __m256i shuffle = _mm256_setr_epi8(NOU_RGBA_TO_RG_SHUFFLE, NOU_RGBA_TO_RG_SHUFFLE);
+			size_t i = 0;
+			for (; i + 16 <= count; i += 16) {
+				__m256i a = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i*)&rgba[i * 4]), shuffle);
+				__m256i b = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i*)&rgba[i * 4 + 32]), shuffle);
+				//Quarters come out as pixels 0-3, 8-11, 4-7, 12-15
+				__m256i packed = _mm256_permute4x64_epi64(_mm256_unpacklo_epi64(a, b), _MM_SHUFFLE(3, 1, 2, 0));
+				_mm256_storeu_si256((__m256i*)&rg[i * 2], packed);
+			}
+			packScalar(rgba, rg, i, count);
+		}
+
+		NOU_TARGET("avx2") void srgbToLinearAVX2(const uint8_t* rgba, float* linear, size_t count) {
+			const float* table = getTables().srgbToLinear;
+			const __m256 invMax = _mm256_set1_ps(INV_255);
+			size_t i = 0;
+			for (; i + 2 <= count; i += 2) {
+				__m256i codes = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)&rgba[i * 4]));
+				__m256 color = _mm256_i32gather_ps(table, codes, 4);
+				__m256 alpha = _mm256_mul_ps(_mm256_cvtepi32_ps(codes), invMax);
+				_mm256_storeu_ps(&linear[i * 4], _mm256_blend_ps(color, alpha, 0x88));
+			}
+			srgbToLinearScalar(rgba, linear, i, count);
+		}
+
+		NOU_TARGET("avx2") void linearToSrgbAVX2(const float* linear, uint8_t* rgba, size_t count) {
+			const int* table = (const int*)getTables().linearToSrgb;
+			const __m256 zero = _mm256_setzero_ps();
+			const __m256 one = _mm256_set1_ps(1.0f);
+			const __m256 steps = _mm256_set1_ps((float)(LINEAR_STEPS - 1));
+			const __m256 codeMax = _mm256_set1_ps(255.0f);
+			//Low byte of every dword to the front of its lane, then both lanes together
+			const __m256i narrow = _mm256_setr_epi8(0, 4, 8, 12, (char)0x80, (char)0x80, (char)0x80, (char)0x80, (char)0x80, (char)0x80, (char)0x80, (char)0x80, (char)0x80, (char)0x80, (char)0x80, (char)0x80,
+				0, 4, 8, 12, (char)0x80, (char)0x80, (char)0x80, (char)0x80, (char)0x80, (char)0x80, (char)0x80, (char)0x80, (char)0x80, (char)0x80, (char)0x80, (char)0x80);
+			const __m256i join = _mm256_setr_epi32(0, 4, 0, 0, 0, 0, 0, 0);
+			size_t i = 0;
+			for (; i + 2 <= count; i += 2) {
+				__m256 values = _mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(&linear[i * 4]), zero), one);
+				__m256i color = _mm256_i32gather_epi32(table, _mm256_cvtps_epi32(_mm256_mul_ps(values, steps)), 4);
+				__m256i alpha = _mm256_cvtps_epi32(_mm256_mul_ps(values, codeMax));
+				__m256i codes = _mm256_shuffle_epi8(_mm256_blend_epi32(color, alpha, 0x88), narrow);
+				_mm_storel_epi64((__m128i*)&rgba[i * 4], _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(codes, join)));
+			}
+			linearToSrgbScalar(linear, rgba, i, count);
+		}
+
+#endif
+	}
+
+	Isa getSupportedIsa() {
+		return SUPPORTED_ISA;
+	}
+
+	Isa getActiveIsa() {
+		return std::min({ SUPPORTED_ISA, sMaxIsa.load(), tBenchmarkIsa });
+	}
+
+	void setMaxIsa(Isa isa) {
+		sMaxIsa = isa;
+	}
+
+	const char* getIsaName(Isa isa) {
+		switch (isa) {
+		case Isa::Scalar: return "Scalar";
+		case Isa::SSSE3: return "SSSE3";
+		case Isa::AVX2: return "AVX2";
+		}
+		return "";
+	}
+
+	void expandRGBToRGBA(const uint8_t* rgb, uint8_t* rgba, size_t count) {
+#ifdef NOU_PIXEL_X86
+		switch (getActiveIsa()) {
+		case Isa::AVX2: expandAVX2(rgb, rgba, count); return;
+		case Isa::SSSE3: expandSSSE3(rgb, rgba, count); return;
+		default: break;
+		}
+#endif
+		expandScalar(rgb, rgba, 0, count);
+	}
+
+	void packRGBAToRG(const uint8_t* rgba, uint8_t* rg, size_t count) {
+#ifdef NOU_PIXEL_X86
+		switch (getActiveIsa()) {
+		case Isa::AVX2: packAVX2(rgba, rg, count); return;
+		case Isa::SSSE3: packSSSE3(rgba, rg, count); return;
+		default: break;
+		}
+#endif
+		packScalar(rgba, rg, 0, count);
+	}
+
+	//The table lookups need a gather, below AVX2 they stay scalar
+	void srgbToLinear(const uint8_t* rgba, float* linear, size_t count) {
+#ifdef NOU_PIXEL_X86
+		if (getActiveIsa() == Isa::AVX2) {
+			srgbToLinearAVX2(rgba, linear, count);
+			return;
+		}
+#endif
+		srgbToLinearScalar(rgba, linear, 0, count);
+	}
+
+	void linearToSrgb(const float* linear, uint8_t* rgba, size_t count) {
+#ifdef NOU_PIXEL_X86
+		if (getActiveIsa() == Isa::AVX2) {
+			linearToSrgbAVX2(linear, rgba, count);
+			return;
+		}
+#endif
+		linearToSrgbScalar(linear, rgba, 0, count);
+	}
+
+	void premultiplyAlphaSrgb(uint8_t* rgba, size_t count) {
+		const size_t CHUNK = 256;
+		float linear[CHUNK * 4];
+		for (size_t begin = 0; begin < count; begin += CHUNK) {
+			size_t chunk = std::min(CHUNK, count - begin);
+			srgbToLinear(&rgba[begin * 4], linear, chunk);
+			for (size_t i = 0; i < chunk * 4; i += 4) {
+				linear[i + 0] *= linear[i + 3];
+				linear[i + 1] *= linear[i + 3];
+				linear[i + 2] *= linear[i + 3];
+			}
+			linearToSrgb(linear, &rgba[begin * 4], chunk);
+		}
+	}
+
+	std::vector<BenchmarkResult> benchmark(size_t count) {
+		std::vector<uint8_t> rgba(count * 4);
+		std::vector<uint8_t> rgb(count * 3);
+		std::vector<uint8_t> rg(count * 2);
+		std::vector<float> linear(count * 4);
+		std::vector<uint8_t> scratch(count * 4);
+		std::mt19937 random(7);
+		for (uint8_t& value : rgba) value = (uint8_t)random();
+		for (uint8_t& value : rgb) value = (uint8_t)random();
+		srgbToLinearScalar(rgba.data(), linear.data(), 0, count);
+
+		//In place conversions get a fresh copy before each run, outside of the measurement
+		struct Operation {
+			const char* name;
+			void(*run)(void*, size_t);
+			void(*prepare)(void*);
+		};
+		struct Buffers {
+			std::vector<uint8_t>* rgba;
+			std::vector<uint8_t>* rgb;
+			std::vector<uint8_t>* rg;
+			std::vector<float>* linear;
+			std::vector<uint8_t>* scratch;
+		} buffers{ &rgba, &rgb, &rg, &linear, &scratch };
+		const Operation operations[] = {
+			{ "RGB to RGBA", [](void* b, size_t n) { Buffers& buf = *(Buffers*)b; expandRGBToRGBA(buf.rgb->data(), buf.scratch->data(), n); }, nullptr },
+			{ "RGBA to RG", [](void* b, size_t n) { Buffers& buf = *(Buffers*)b; packRGBAToRG(buf.rgba->data(), buf.rg->data(), n); }, nullptr },
+			{ "sRGB to linear", [](void* b, size_t n) { Buffers& buf = *(Buffers*)b; srgbToLinear(buf.rgba->data(), buf.linear->data(), n); }, nullptr },
+			{ "Linear to sRGB", [](void* b, size_t n) { Buffers& buf = *(Buffers*)b; linearToSrgb(buf.linear->data(), buf.scratch->data(), n); }, nullptr },
+			{ "Premultiply sRGB", [](void* b, size_t n) { Buffers& buf = *(Buffers*)b; premultiplyAlphaSrgb(buf.scratch->data(), n); },
+				[](void* b) { Buffers& buf = *(Buffers*)b; *buf.scratch = *buf.rgba; } }
+		};
+
+		std::vector<BenchmarkResult> results;
+		for (const Operation& operation : operations) {
+			BenchmarkResult result{ operation.name, { -1.0, -1.0, -1.0 } };
+			for (uint32_t isa = 0; isa <= (uint32_t)SUPPORTED_ISA; isa++) {
+				tBenchmarkIsa = (Isa)isa;
+				//Best of a few runs, the first one also warms the caches and tables
+				double best = 0.0;
+				for (uint32_t run = 0; run < 5; run++) {
+					if (operation.prepare) operation.prepare(&buffers);
+					auto start = std::chrono::high_resolution_clock::now();
+					operation.run(&buffers, count);
+					double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+					if (run == 0 || ms < best) best = ms;
+				}
+				result.milliseconds[isa] = best;
+			}
+			results.push_back(result);
+		}
+		tBenchmarkIsa = Isa::AVX2;
+		return results;
+	}
+
+}
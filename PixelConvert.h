@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*
+	Pixel format conversions for texture ingest. Every function has a scalar version and x86 versions
+	that are picked at runtime by what the CPU supports. All versions give bit identical results.
+	RGBA data is 4 bytes per pixel in RGBA order, linear float data 4 floats per pixel.
+*/
+namespace PixelConvert {
+
+	enum class Isa : uint32_t {
+		Scalar = 0,
+		SSSE3 = 1,
+		AVX2 = 2
+	};
+
+	/* Best instruction set of this CPU */
+	Isa getSupportedIsa();
+	/* Instruction set the conversions use, the supported one limited by setMaxIsa */
+	Isa getActiveIsa();
+	/* Caps the instruction set, meant for comparisons and benchmarks */
+	void setMaxIsa(Isa isa);
+	const char* getIsaName(Isa isa);
+
+	/* RGB8 to RGBA8 with opaque alpha */
+	void expandRGBToRGBA(const uint8_t* rgb, uint8_t* rgba, size_t count);
+	/* Keeps only red and green, for two channel normal maps. rg may point to rgba to pack in place */
+	void packRGBAToRG(const uint8_t* rgba, uint8_t* rg, size_t count);
+	/* Color channels are decoded from sRGB, alpha is linear and only scaled to 0..1 */
+	void srgbToLinear(const uint8_t* rgba, float* linear, size_t count);
+	/* Inverse of srgbToLinear, values are clamped to 0..1. Color goes through a 12 bit table, at most one code off exact rounding but every sRGB code survives a round trip */
+	void linearToSrgb(const float* linear, uint8_t* rgba, size_t count);
+	/* Multiplies sRGB encoded color by alpha in place, the product is taken in linear space */
+	void premultiplyAlphaSrgb(uint8_t* rgba, size_t count);
+
+	struct BenchmarkResult {
+		const char* name;
+		double milliseconds[3]; //indexed by Isa, negative if the CPU lacks it
+	};
+	/*
+		Times every conversion on count random pixels with every supported instruction set.
+		Takes a while and about 30 bytes per pixel, keep it off the render thread. Other threads are not capped meanwhile.
+	*/
+	std::vector<BenchmarkResult> benchmark(size_t count);
+
+}
@@ -2,22 +2,56 @@
 
 //for debug scene
 #include "Material.h"
+#include "Camera.h"
 #include "Mesh.h"
+#include "GeometryPool.h"
+#include "SceneLoader.h"
+#include "TextureCache.h"
+#include "TextureStreamer.h"
+#include "PixelConvert.h"
+
+#include <algorithm>
+#include <future>
 
 void Renderer::drawScene(const GraphicsVulkan& gfx) {
 	//DebugScene START
 
-	static Material mat(gfx, *this);
+	static TextureCache textures(gfx);
+	static Material mat(gfx, *this, textures.Get("textures/test.png"));
+	static Camera camera(gfx.SURFACE_WIDTH, gfx.SURFACE_HEIGHT);
+	static GeometryPool geometryPool(gfx, sizeof(VertexFormat::GpuVertex), 2 * 1024 * 1024, 32 * 1024 * 1024);
 	static std::vector<Mesh*> meshes;
-	if (meshes.size() == 0) {
-		Assimp::Importer imp;
-		const aiScene* scene = imp.ReadFile("Resources/sponza.obj", aiProcess_Triangulate | aiProcess_JoinIdenticalVertices | aiProcess_FlipUVs);
-		meshes.resize(scene->mNumMeshes);
-		for (int i = 0; i < scene->mNumMeshes; i++) {
-			meshes[i] = new Mesh(gfx, scene->mMeshes[i]);
+	static TextureStreamer streamer(gfx, 256 * 1024 * 1024);
+	static SceneLoader loader(gfx, geometryPool, streamer);
+	//Per material index of the scene, meshes without texture use the default image at table index 0
+	static std::vector<TextureStreamer::Handle> materialTextures;
+	static std::vector<uint32_t> materialTableIndices;
+	if (loader.GetState() == SceneLoader::State::Idle) {
+		loader.Load("Resources/sponza.obj", "Resources/sponza.meshcache");
+	}
+	loader.CollectLoaded(meshes);
+	if (loader.CollectMaterialTextures(materialTextures)) {
+		materialTableIndices.assign(materialTextures.size(), 0);
+		for (size_t i = 0; i < materialTextures.size(); i++) {
+			if (materialTextures[i] != TextureStreamer::INVALID_HANDLE) materialTableIndices[i] = mat.AddImage(streamer.GetImage(materialTextures[i]));
 		}
 	}
 
+	//Mips requested while drawing the last frame are streamed in, swapped images reach the material here
+	streamer.Update();
+	for (size_t i = 0; i < materialTextures.size(); i++) {
+		if (materialTextures[i] != TextureStreamer::INVALID_HANDLE) mat.SetImage(materialTableIndices[i], streamer.GetImage(materialTextures[i]));
+	}
+	static int textureBudgetMB = 256;
+	ImGui::SliderInt("Texture budget (MB)", &textureBudgetMB, 16, 2048);
+	streamer.SetBudget((vk::DeviceSize)textureBudgetMB * 1024 * 1024);
+	//The allocator also sees replaced images still held by frames in flight and the textures outside the streamer
+	gfx.GetAllocator().SetBudget(MemoryAllocator::Category::Texture, (vk::DeviceSize)textureBudgetMB * 1024 * 1024 * 5 / 4);
+	if (loader.IsLoading()) {
+		ImGui::Text("Loading scene: %s", loader.GetStateName());
+		ImGui::ProgressBar(loader.GetProgress());
+	}
+
 
 	//DebugScene END
 
@@ -26,19 +60,158 @@ void Renderer::drawScene(const GraphicsVulkan& gfx) {
 
 	mBeginInfo.framebuffer = mFramebuffers[currentSwapchainImageIndex];
 
-	mat.UpdateUniforms(gfx.mDevice, cmdBuffer, gfx.currentFrame);
+	camera.Update();
+	//The fence of this frame was waited in onFrameStart, its uniform region is free again
+	mUniformRing->BeginFrame(gfx.currentFrame);
+	mSecondaryPool->BeginFrame(gfx.currentFrame);
+	mat.UpdateUniforms(gfx.mDevice, gfx.currentFrame, camera);
+
+	static float maxLodError = 1.0f;
+	ImGui::SliderFloat("LOD error (px)", &maxLodError, 0.0f, 16.0f);
+	float projectionScale = camera.GetProjectionScale();
+
+	static bool frustumCulling = true;
+	static bool coneCulling = true;
+	ImGui::Checkbox("Frustum culling", &frustumCulling);
+	ImGui::Checkbox("Cone culling", &coneCulling);
+	Mesh::CullInfo cull;
+	camera.GetFrustumPlanes(cull.frustumPlanes);
+	cull.cameraPos = camera.GetPosition();
+	cull.frustumCulling = frustumCulling;
+	cull.coneCulling = coneCulling;
+	Mesh::CullStats cullStats{};
 
-	cmdBuffer.beginRenderPass(mBeginInfo, vk::SubpassContents::eInline);
-	mat.Bind(cmdBuffer);
-	for (Mesh* m : meshes) {
-		m->Bind(cmdBuffer);
-		cmdBuffer.drawIndexed(m->GetIndexCount(), 1, 0, 0, 0);
+	//All meshes share the pool buffers, sorted by index width the index buffer only has to be rebound once per chunk
+	static std::vector<Mesh*> drawList;
+	drawList.clear();
+	for (vk::IndexType indexType : { vk::IndexType::eUint16, vk::IndexType::eUint32 }) {
+		for (Mesh* m : meshes) {
+			if (m->GetIndexType() == indexType) drawList.push_back(m);
+		}
 	}
+
+	//Contiguous chunks of the draw list are recorded in parallel, each into its own secondary buffer
+	struct MipRequest {
+		TextureStreamer::Handle texture;
+		float screenSize;
+	};
+	struct Chunk {
+		vk::CommandBuffer cmdBuffer;
+		Mesh::CullStats stats{};
+		std::vector<MipRequest> mipRequests;
+	};
+	uint32_t chunkCount = std::min(mSecondaryPool->GetSlotCount(), ((uint32_t)drawList.size() + MIN_DRAWS_PER_CHUNK - 1) / MIN_DRAWS_PER_CHUNK);
+	std::vector<Chunk> chunks(chunkCount);
+	vk::CommandBufferInheritanceInfo inheritance{ mRenderpass, 0, mBeginInfo.framebuffer };
+	ThreadPool::Shared().ParallelFor(chunkCount, [&](uint32_t chunkIndex) {
+		Chunk& chunk = chunks[chunkIndex];
+		size_t begin = drawList.size() * chunkIndex / chunkCount;
+		size_t end = drawList.size() * (chunkIndex + 1) / chunkCount;
+
+		//Secondary buffers inherit no state, every chunk binds everything itself
+		vk::CommandBuffer secondary = mSecondaryPool->Begin(chunkIndex, inheritance);
+		mat.Bind(secondary);
+		geometryPool.BindVertexBuffer(secondary);
+		bool indexBufferBound = false;
+		vk::IndexType boundIndexType = vk::IndexType::eUint16;
+		for (size_t i = begin; i < end; i++) {
+			Mesh* m = drawList[i];
+			if (!indexBufferBound || m->GetIndexType() != boundIndexType) {
+				boundIndexType = m->GetIndexType();
+				geometryPool.BindIndexBuffer(secondary, boundIndexType);
+				indexBufferBound = true;
+			}
+			uint32_t lod = m->SelectLod(cull.cameraPos, projectionScale, maxLodError);
+			uint32_t materialIndex = m->GetMaterialIndex();
+			bool textured = materialIndex < materialTextures.size() && materialTextures[materialIndex] != TextureStreamer::INVALID_HANDLE;
+			mat.PushTextureIndex(secondary, textured ? materialTableIndices[materialIndex] : 0);
+			mat.PushVertexDecode(secondary, m->GetVertexDecode());
+			uint32_t visibleMeshlets = chunk.stats.visibleMeshlets;
+			m->DrawCulled(secondary, lod, cull, chunk.stats);
+
+			//Only textures that really reach the screen ask for finer mips, handed to the streamer after recording
+			if (textured && chunk.stats.visibleMeshlets > visibleMeshlets) {
+				chunk.mipRequests.push_back(MipRequest{ materialTextures[materialIndex], m->GetScreenSize(cull.cameraPos, projectionScale) });
+			}
+		}
+		secondary.end();
+		chunk.cmdBuffer = secondary;
+	});
+
+	cmdBuffer.beginRenderPass(mBeginInfo, vk::SubpassContents::eSecondaryCommandBuffers);
+	std::vector<vk::CommandBuffer> secondaries;
+	for (Chunk& chunk : chunks) secondaries.push_back(chunk.cmdBuffer);
+	if (!secondaries.empty()) cmdBuffer.executeCommands(secondaries);
 	cmdBuffer.endRenderPass();
 
+	for (const Chunk& chunk : chunks) {
+		cullStats.meshlets += chunk.stats.meshlets;
+		cullStats.visibleMeshlets += chunk.stats.visibleMeshlets;
+		cullStats.draws += chunk.stats.draws;
+		cullStats.triangles += chunk.stats.triangles;
+		for (const MipRequest& request : chunk.mipRequests) streamer.RequestMip(request.texture, streamer.ComputeMip(request.texture, request.screenSize));
+	}
+	ImGui::Text("Triangles: %u", cullStats.triangles);
+	ImGui::Text("Meshlets: %u / %u in %u draws", cullStats.visibleMeshlets, cullStats.meshlets, cullStats.draws);
+	ImGui::Text("Recorded in %u secondary command buffers", chunkCount);
+	TextureStreamer::Stats textureStats = streamer.GetStats();
+	ImGui::Text("Textures: %u (%u streamed, %u pending), %.1f / %.1f MB resident", textureStats.textures, textureStats.streamed, textureStats.pendingJobs,
+		textureStats.residentSize / (1024.0f * 1024.0f), textureStats.fullSize / (1024.0f * 1024.0f));
+	drawMemoryPanel(gfx);
+
+	//Scalar is the per component loop stb_image runs for its own conversions, the run goes to a worker so frames keep going
+	static std::vector<PixelConvert::BenchmarkResult> pixelBenchmark;
+	static std::future<std::vector<PixelConvert::BenchmarkResult>> pixelBenchmarkJob;
+	if (pixelBenchmarkJob.valid() && pixelBenchmarkJob.wait_for(std::chrono::seconds(0)) == std::future_status::ready) pixelBenchmark = pixelBenchmarkJob.get();
+	if (pixelBenchmarkJob.valid()) {
+		ImGui::Text("Benchmarking pixel conversion...");
+	} else if (ImGui::Button("Benchmark pixel conversion")) {
+		auto task = std::make_shared<std::packaged_task<std::vector<PixelConvert::BenchmarkResult>()>>([]() { return PixelConvert::benchmark(PIXEL_BENCHMARK_COUNT); });
+		pixelBenchmarkJob = task->get_future();
+		ThreadPool::Shared().Submit([task]() { (*task)(); });
+	}
+	for (const PixelConvert::BenchmarkResult& result : pixelBenchmark) {
+		ImGui::Text("%s: %.2f / %.2f / %.2f ms (Scalar / SSSE3 / AVX2)", result.name, result.milliseconds[0], result.milliseconds[1], result.milliseconds[2]);
+	}
+
 	ImGui::Render();
 
 	cmdBuffer.beginRenderPass(vk::RenderPassBeginInfo{ mImguiRenderpass, mImguiFramebuffers[currentSwapchainImageIndex], mBeginInfo.renderArea, 1, mBeginInfo.pClearValues }, vk::SubpassContents::eInline);
 	ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), cmdBuffer);
 	cmdBuffer.endRenderPass();
+}
+
+void Renderer::drawMemoryPanel(const GraphicsVulkan& gfx) {
+	if (!ImGui::CollapsingHeader("GPU memory")) return;
+	const float MB = 1024.0f * 1024.0f;
+
+	MemoryAllocator::Stats stats = gfx.GetAllocator().GetStats();
+	for (uint32_t i = 0; i < (uint32_t)MemoryAllocator::Category::Count; i++) {
+		const MemoryAllocator::CategoryStats& category = stats.categories[i];
+		const char* name = MemoryAllocator::GetCategoryName((MemoryAllocator::Category)i);
+		if (category.budget == 0) {
+			ImGui::Text("%s: %.1f MB in %u allocations, %.1f MB peak", name, category.size / MB, category.allocations, category.peak / MB);
+		} else {
+			ImVec4 color = category.size > category.budget ? ImVec4(1.0f, 0.3f, 0.3f, 1.0f) : ImGui::GetStyleColorVec4(ImGuiCol_Text);
+			ImGui::TextColored(color, "%s: %.1f / %.1f MB in %u allocations, %.1f MB peak", name, category.size / MB, category.budget / MB, category.allocations, category.peak / MB);
+		}
+	}
+
+	StagingPool::Stats stagingStats = gfx.GetStagingPool().GetStats();
+	ImGui::Text("Staging pool: %u buffers, %.1f MB pooled, %.1f MB peak, %llu / %llu acquires reused", stagingStats.bufferCount, stagingStats.pooledSize / MB,
+		stagingStats.highWaterMark / MB, (unsigned long long)stagingStats.reuses, (unsigned long long)stagingStats.acquires);
+	ImGui::Text("Deletion queue: %zu pending", gfx.GetDeletionQueue().GetPendingCount());
+
+	ImGui::Separator();
+	for (uint32_t i = 0; i < (uint32_t)stats.heaps.size(); i++) {
+		const MemoryAllocator::HeapStats& heap = stats.heaps[i];
+		ImGui::Text("Heap %u (%s, %.0f MB): %.1f / %.1f MB used in %u blocks and %u dedicated", i, heap.deviceLocal ? "device" : "host", heap.heapSize / MB,
+			heap.used / MB, heap.allocated / MB, heap.blocks, heap.dedicated);
+		if (!stats.memoryBudget) continue;
+		//Swapchain images, ImGui's own buffers and anything else the allocator never sees
+		vk::DeviceSize untracked = heap.driverUsage > heap.allocated ? heap.driverUsage - heap.allocated : 0;
+		ImVec4 color = heap.driverUsage > heap.driverBudget ? ImVec4(1.0f, 0.3f, 0.3f, 1.0f) : ImGui::GetStyleColorVec4(ImGuiCol_Text);
+		ImGui::TextColored(color, "    driver: %.1f / %.1f MB budget, %.1f MB untracked", heap.driverUsage / MB, heap.driverBudget / MB, untracked / MB);
+	}
+	if (!stats.memoryBudget) ImGui::TextDisabled("VK_EXT_memory_budget not supported, no driver budget");
 }
\ No newline at end of file
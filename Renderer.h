@@ -5,6 +5,12 @@
 #include "Imgui/imgui_impl_vulkan.h"
 
 #include "GraphicsVulkan.h"
+#include "SamplerCache.h"
+#include "UniformRing.h"
+#include "SecondaryCommandPool.h"
+#include "ThreadPool.h"
+
+#include <memory>
 
 //VulkanRenderer
 class Renderer {
@@ -13,7 +19,11 @@ class Renderer {
 public:
 	Renderer(const GraphicsVulkan& gfx) {
 		mGfx = &gfx;
-		createDepthBuffer(gfx.mDevice, gfx.mPhysicalDevice, gfx.SURFACE_WIDTH, gfx.SURFACE_HEIGHT);
+		mSamplerCache = std::make_unique<SamplerCache>(gfx);
+		mUniformRing = std::make_unique<UniformRing>(gfx, UNIFORM_RING_SIZE);
+		//One slot for every worker plus the render thread, which records a chunk itself
+		mSecondaryPool = std::make_unique<SecondaryCommandPool>(gfx, ThreadPool::Shared().GetThreadCount() + 1);
+		createDepthBuffer(gfx.mDevice, gfx.mPhysicalDevice, gfx.GetAllocator(), gfx.SURFACE_WIDTH, gfx.SURFACE_HEIGHT);
 		createRenderPass(gfx.mDevice, gfx.mSwapchainFormat);
 		createBuffers(gfx.mDevice, gfx.SURFACE_WIDTH, gfx.SURFACE_HEIGHT, gfx.SWAPCHAIN_SIZE, gfx.mSwapchainImageViews);
 		createDescriptorPool(gfx.mDevice);
@@ -23,11 +33,31 @@ public:
 		createBeginInfo(gfx.SURFACE_WIDTH, gfx.SURFACE_HEIGHT);
 	}
 	~Renderer() {
-		mGfx->mDevice.waitIdle();
-		mGfx->mDevice.destroyDescriptorPool(mDescriptorPool);
-		mGfx->mDevice.destroyDescriptorPool(mImguiDescriptorPool);
-		for (auto fb : mFramebuffers) mGfx->mDevice.destroyFramebuffer(fb);
-		mGfx->mDevice.destroyRenderPass(mRenderpass);
+		//The last frames may still be in flight, everything goes once they are done
+		vk::Device device = mGfx->mDevice;
+		MemoryAllocator* allocator = &mGfx->GetAllocator();
+		vk::DescriptorPool descriptorPool = mDescriptorPool;
+		vk::DescriptorPool imguiDescriptorPool = mImguiDescriptorPool;
+		std::vector<vk::Framebuffer> framebuffers = mFramebuffers;
+		vk::RenderPass renderpass = mRenderpass;
+		vk::ImageView depthImageView = mDepthImageView;
+		vk::Image depthImage = mDepthImage;
+		MemoryAllocator::Allocation depthImageMemory = mDepthImageMemory;
+		//Shared so the deleter stays copyable
+		std::shared_ptr<SamplerCache> samplerCache = std::move(mSamplerCache);
+		std::shared_ptr<UniformRing> uniformRing = std::move(mUniformRing);
+		std::shared_ptr<SecondaryCommandPool> secondaryPool = std::move(mSecondaryPool);
+		mGfx->GetDeletionQueue().Push([=]() mutable {
+			device.destroyDescriptorPool(descriptorPool);
+			device.destroyDescriptorPool(imguiDescriptorPool);
+			for (auto fb : framebuffers) device.destroyFramebuffer(fb);
+			device.destroyRenderPass(renderpass);
+			device.destroyImageView(depthImageView);
+			allocator->DestroyImage(depthImage, depthImageMemory);
+			samplerCache.reset();
+			uniformRing.reset();
+			secondaryPool.reset();
+		});
 	}
 	Renderer(const Renderer&) = delete;
 	Renderer& operator= (const Renderer&) = delete;
@@ -38,8 +68,26 @@ public:
 	vk::RenderPass GetRenderPass() const {
 		return mRenderpass;
 	}
+	/* Shared by all materials, outlives them */
+	SamplerCache& GetSamplerCache() const {
+		return *mSamplerCache;
+	}
+	/* Per frame uniform data, the current frame's region is started by drawScene */
+	UniformRing& GetUniformRing() const {
+		return *mUniformRing;
+	}
+
+	//Size of the bindless texture table, clamped further to the device limits by the material
+	static const uint32_t MAX_TEXTURES = 1024;
 	
 private:
+	static const uint32_t MAX_MATERIAL_SETS = 8;
+	//Uniform memory per frame in flight
+	static constexpr vk::DeviceSize UNIFORM_RING_SIZE = 1024 * 1024;
+	//Fewer meshes than this per secondary command buffer are not worth handing to another thread
+	static const uint32_t MIN_DRAWS_PER_CHUNK = 64;
+	//1M pixels keep the benchmark buffers around 30MB
+	static const uint32_t PIXEL_BENCHMARK_COUNT = 1024 * 1024;
 
 	//Init
 	void createRenderPass(vk::Device device, vk::Format swapchainFormat) {
@@ -76,19 +124,23 @@ private:
 		}
 	}
 	void createDescriptorPool(vk::Device device) {
-		//Gather Data about all Materials that the renderer can use
-		vk::DescriptorPoolSize poolSizeUniforms{ vk::DescriptorType::eUniformBuffer, 1 };
-		vk::DescriptorPoolSize poolSizeSampler{ vk::DescriptorType::eCombinedImageSampler, 1 };
+		//A material takes one set per frame in flight, each with a uniform buffer and the whole texture table
+		vk::DescriptorPoolSize poolSizeUniforms{ vk::DescriptorType::eUniformBufferDynamic, MAX_MATERIAL_SETS };
+		vk::DescriptorPoolSize poolSizeSampler{ vk::DescriptorType::eCombinedImageSampler, MAX_MATERIAL_SETS * MAX_TEXTURES };
 		std::vector<vk::DescriptorPoolSize> pools({ poolSizeUniforms, poolSizeSampler });
-		vk::DescriptorPoolCreateInfo poolCreateInfo{ {}, 1, (uint32_t)pools.size(), pools.data()};
+		vk::DescriptorPoolCreateInfo poolCreateInfo{ {}, MAX_MATERIAL_SETS, (uint32_t)pools.size(), pools.data()};
 		mDescriptorPool = device.createDescriptorPool(poolCreateInfo);
 	}
-	void createDepthBuffer(vk::Device device, vk::PhysicalDevice physDevice, uint32_t surfaceWidth, uint32_t surfaceHeight) {
+	void createDepthBuffer(vk::Device device, vk::PhysicalDevice physDevice, MemoryAllocator& allocator, uint32_t surfaceWidth, uint32_t surfaceHeight) {
 		mDepthFormat = VulkanUtils::findSupportedFormat(physDevice, { vk::Format::eD32Sfloat, vk::Format::eD32SfloatS8Uint, vk::Format::eD24UnormS8Uint }, vk::ImageTiling::eOptimal, vk::FormatFeatureFlagBits::eDepthStencilAttachment);
-		VulkanUtils::createImage(device, physDevice, mDepthFormat, surfaceWidth, surfaceHeight, vk::ImageUsageFlagBits::eDepthStencilAttachment, mDepthImage, mDepthImageMemory);
+		//Render targets get their own memory, they are recreated with the swapchain and would only fragment the blocks
+		allocator.CreateImage(mDepthFormat, surfaceWidth, surfaceHeight, 1, vk::ImageUsageFlagBits::eDepthStencilAttachment, MemoryAllocator::Category::Depth, mDepthImage, mDepthImageMemory, 1, true);
 		mDepthImageView = VulkanUtils::createImageView(device, mDepthImage, mDepthFormat, vk::ImageAspectFlagBits::eDepth);
 	}
 
+	/* Allocator totals per category and heap, with the driver budget when available */
+	void drawMemoryPanel(const GraphicsVulkan& gfx);
+
 	//Dear ImGui
 	void initImgui(vk::Instance instance, vk::PhysicalDevice physDevice, vk::Device device, uint32_t queueFamily, vk::Queue queue, uint32_t swapchainSize,
 		vk::Format swapchainFormat, vk::CommandPool cmdPool, uint32_t surfaceWidth, uint32_t surfaceHeight, std::vector<vk::ImageView> swapchainImageViews) {
@@ -143,7 +195,7 @@ private:
 
 		vk::CommandBuffer tmpCmdBuffer = VulkanUtils::startSingleUserCmdBuffer(device, cmdPool);
 		ImGui_ImplVulkan_CreateFontsTexture(tmpCmdBuffer);
-		VulkanUtils::endSingleUseCmdBuffer(tmpCmdBuffer, queue);
+		VulkanUtils::endSingleUseCmdBuffer(device, cmdPool, tmpCmdBuffer, queue);
 
 
 		mImguiFramebuffers.resize(swapchainSize);
@@ -160,10 +212,13 @@ private:
 
 	vk::Format mDepthFormat;
 	vk::Image mDepthImage;
-	vk::DeviceMemory mDepthImageMemory;
+	MemoryAllocator::Allocation mDepthImageMemory;
 	vk::ImageView mDepthImageView;
 
 	vk::DescriptorPool mDescriptorPool;
+	std::unique_ptr<SamplerCache> mSamplerCache;
+	std::unique_ptr<UniformRing> mUniformRing;
+	std::unique_ptr<SecondaryCommandPool> mSecondaryPool;
 
 	vk::RenderPass mImguiRenderpass;
 	vk::DescriptorPool mImguiDescriptorPool;
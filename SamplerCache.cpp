@@ -0,0 +1,70 @@
+#include "SamplerCache.h"
+
+#include "FileUtils.h"
+
+#include <algorithm>
+
+SamplerCache::SamplerCache(const GraphicsVulkan& gfx) {
+	mGfx = &gfx;
+}
+
+SamplerCache::~SamplerCache() {
+	for (auto& entry : mSamplers) mGfx->mDevice.destroySampler(entry.second);
+}
+
+vk::Sampler SamplerCache::Get(vk::SamplerCreateInfo createInfo) {
+	if (createInfo.pNext != nullptr) throw std::runtime_error("SamplerCache does not support chained create infos");
+
+	if (createInfo.anisotropyEnable && mGfx->mSamplerAnisotropy) {
+		createInfo.maxAnisotropy = std::clamp(createInfo.maxAnisotropy, 1.0f, mGfx->mMaxSamplerAnisotropy);
+	} else {
+		createInfo.anisotropyEnable = VK_FALSE;
+		createInfo.maxAnisotropy = 1.0f;
+	}
+
+	std::lock_guard<std::mutex> lock(mMutex);
+	auto known = mSamplers.find(createInfo);
+	if (known != mSamplers.end()) return known->second;
+
+	if (mSamplers.size() >= mGfx->mPhysicalDevice.getProperties().limits.maxSamplerAllocationCount) {
+		throw std::runtime_error("Sampler allocation limit reached");
+	}
+	vk::Sampler sampler = mGfx->mDevice.createSampler(createInfo);
+	mSamplers.emplace(createInfo, sampler);
+	return sampler;
+}
+
+vk::Sampler SamplerCache::GetTrilinear() {
+	//The image view limits the lod range to the levels an image really has
+	vk::SamplerCreateInfo createInfo{ {}, vk::Filter::eLinear, vk::Filter::eLinear, vk::SamplerMipmapMode::eLinear,
+		vk::SamplerAddressMode::eRepeat, vk::SamplerAddressMode::eRepeat, vk::SamplerAddressMode::eRepeat,
+		0.0f, VK_TRUE, 16.0f, VK_FALSE, vk::CompareOp::eAlways, 0.0f, VK_LOD_CLAMP_NONE, vk::BorderColor::eIntOpaqueBlack, VK_FALSE };
+	return Get(createInfo);
+}
+
+size_t SamplerCache::GetCount() const {
+	std::lock_guard<std::mutex> lock(mMutex);
+	return mSamplers.size();
+}
+
+size_t SamplerCache::CreateInfoHash::operator()(const vk::SamplerCreateInfo& createInfo) const {
+	//Field by field, the struct has padding that is not guaranteed to be zero
+	uint64_t hash = FileUtils::hashFNV1a(&createInfo.flags, sizeof(createInfo.flags));
+	auto add = [&hash](const auto& value) { hash = FileUtils::hashFNV1a(&value, sizeof(value), hash); };
+	add(createInfo.magFilter);
+	add(createInfo.minFilter);
+	add(createInfo.mipmapMode);
+	add(createInfo.addressModeU);
+	add(createInfo.addressModeV);
+	add(createInfo.addressModeW);
+	add(createInfo.mipLodBias);
+	add(createInfo.anisotropyEnable);
+	add(createInfo.maxAnisotropy);
+	add(createInfo.compareEnable);
+	add(createInfo.compareOp);
+	add(createInfo.minLod);
+	add(createInfo.maxLod);
+	add(createInfo.borderColor);
+	add(createInfo.unnormalizedCoordinates);
+	return (size_t)hash;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "GraphicsVulkan.h"
+
+#include <mutex>
+#include <unordered_map>
+
+/*
+	Shares samplers between everything that asks for the same state, so materials never create their own
+	and the device stays far below maxSamplerAllocationCount.
+	Samplers live as long as the cache, they are cheap and only a handful of states are ever used.
+*/
+class SamplerCache {
+public:
+	SamplerCache(const GraphicsVulkan& gfx);
+	/* The device has to be idle */
+	~SamplerCache();
+	SamplerCache(const SamplerCache&) = delete;
+	SamplerCache& operator=(const SamplerCache&) = delete;
+
+	/*
+		Thread safe. Anisotropy is clamped to the device limit and turned off without the feature,
+		so the state the sampler ends up with is the key. Chained create infos are not supported.
+	*/
+	vk::Sampler Get(vk::SamplerCreateInfo createInfo);
+	/* Trilinear over the whole mip chain with repeat addressing, as anisotropic as the device allows */
+	vk::Sampler GetTrilinear();
+
+	size_t GetCount() const;
+
+private:
+	struct CreateInfoHash {
+		size_t operator()(const vk::SamplerCreateInfo& createInfo) const;
+	};
+
+private:
+	const GraphicsVulkan* mGfx;
+
+	mutable std::mutex mMutex;
+	std::unordered_map<vk::SamplerCreateInfo, vk::Sampler, CreateInfoHash> mSamplers;
+};
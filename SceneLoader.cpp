@@ -0,0 +1,190 @@
+#include "SceneLoader.h"
+
+#include "MeshCache.h"
+#include "ThreadPool.h"
+#include "UploadBatcher.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <iostream>
+
+SceneLoader::SceneLoader(const GraphicsVulkan& gfx, GeometryPool& pool, TextureStreamer& textures) {
+	mGfx = &gfx;
+	mPool = &pool;
+	mTextures = &textures;
+}
+
+SceneLoader::~SceneLoader() {
+	mCancel = true;
+	if (mThread.joinable()) mThread.join();
+
+	//Meshes nobody collected anymore
+	for (Mesh* mesh : mLoaded) delete mesh;
+}
+
+void SceneLoader::Load(const std::string& scenePath, const std::string& cachePath) {
+	if (IsLoading()) throw std::runtime_error("SceneLoader is already loading");
+	if (mThread.joinable()) mThread.join();
+
+	mCancel = false;
+	mMeshCount = 0;
+	mMeshesDone = 0;
+	{
+		std::lock_guard<std::mutex> lock(mLoadedMutex);
+		mMaterialTextures.clear();
+		mMaterialTexturesReady = false;
+	}
+	mState = State::Importing;
+	//A thread of its own, a blocking import would otherwise occupy a pool worker the processing needs
+	mThread = std::thread([this, scenePath, cachePath]() {
+		try {
+			loadScene(scenePath, cachePath);
+			mState = State::Done;
+		} catch (const std::exception& e) {
+			std::cout << "Loading " << scenePath << " failed: " << e.what() << std::endl;
+			mState = State::Failed;
+		}
+	});
+}
+
+void SceneLoader::CollectLoaded(std::vector<Mesh*>& outMeshes) {
+	std::lock_guard<std::mutex> lock(mLoadedMutex);
+	outMeshes.insert(outMeshes.end(), mLoaded.begin(), mLoaded.end());
+	mLoaded.clear();
+}
+
+bool SceneLoader::CollectMaterialTextures(std::vector<TextureStreamer::Handle>& outTextures) {
+	std::lock_guard<std::mutex> lock(mLoadedMutex);
+	if (!mMaterialTexturesReady) return false;
+	outTextures = std::move(mMaterialTextures);
+	mMaterialTextures.clear();
+	mMaterialTexturesReady = false;
+	return true;
+}
+
+float SceneLoader::GetProgress() const {
+	uint32_t count = mMeshCount;
+	return count == 0 ? 0.0f : (float)mMeshesDone / (float)count;
+}
+
+const char* SceneLoader::GetStateName() const {
+	switch (mState) {
+	case State::Idle: return "Idle";
+	case State::Importing: return "Importing";
+	case State::Processing: return "Processing";
+	case State::Uploading: return "Uploading";
+	case State::LoadingTextures: return "Textures";
+	case State::Done: return "Done";
+	case State::Failed: return "Failed";
+	}
+	return "";
+}
+
+void SceneLoader::loadScene(const std::string& scenePath, const std::string& cachePath) {
+	MeshCache cache(cachePath, scenePath);
+	if (cache.IsValid()) {
+		mState = State::Uploading;
+		uploadMeshes(cache.GetMeshes());
+		if (mCancel) return;
+		uploadTextures(cache.GetMaterialTextures());
+		return;
+	}
+
+	Assimp::Importer imp;
+	const aiScene* scene = imp.ReadFile(scenePath, aiProcess_Triangulate | aiProcess_JoinIdenticalVertices | aiProcess_FlipUVs);
+	if (!scene) throw std::runtime_error(imp.GetErrorString());
+
+	mMeshCount = scene->mNumMeshes;
+	mState = State::Processing;
+	std::vector<Mesh::Data> meshData(scene->mNumMeshes);
+	std::vector<Mesh::Geometry> geometry(scene->mNumMeshes);
+
+	//CPU side conversion is independent per mesh
+	ThreadPool::Shared().ParallelFor(scene->mNumMeshes, [&](uint32_t i) {
+		if (mCancel) return;
+		Mesh::LoadMeshData(scene->mMeshes[i], meshData[i]);
+		geometry[i] = meshData[i].GetGeometry();
+		mMeshesDone++;
+	});
+	if (mCancel) return;
+
+	for (uint32_t i = 0; i < scene->mNumMeshes; i++) {
+		const Mesh::Data& data = meshData[i];
+		std::cout << "Mesh " << i << " (" << data.vertices.size() << " vertices): ACMR " << data.importStats.acmr << " -> " << data.optimizedStats.acmr
+			<< ", ATVR " << data.importStats.atvr << " -> " << data.optimizedStats.atvr << ", LODs";
+		for (const Mesh::Lod& lod : data.lods) std::cout << " " << lod.indexCount / 3;
+		std::cout << std::endl;
+	}
+
+	std::vector<VulkanImage::Source> materialTextures = getMaterialTextures(scene, scenePath);
+
+	mState = State::Uploading;
+	uploadMeshes(geometry);
+	if (mCancel) return;
+
+	MeshCache::Write(cachePath, scenePath, geometry, materialTextures);
+	uploadTextures(materialTextures);
+}
+
+void SceneLoader::uploadMeshes(const std::vector<Mesh::Geometry>& geometry) {
+	mMeshCount = (uint32_t)geometry.size();
+	mMeshesDone = 0;
+
+	UploadBatcher batcher(*mGfx, STAGING_SIZE);
+	std::vector<Mesh*> pending;
+	vk::DeviceSize pendingSize = 0;
+	for (const Mesh::Geometry& mesh : geometry) {
+		if (mCancel) break;
+
+		pending.push_back(new Mesh(*mGfx, *mPool, batcher, mesh));
+		pendingSize += sizeof(VertexFormat::GpuVertex) * mesh.vertexCount + Mesh::GetIndexSize(mesh.indexType) * mesh.indexCount;
+		if (pendingSize >= PUBLISH_BATCH_SIZE) {
+			batcher.Flush();
+			publish(pending);
+			pendingSize = 0;
+		}
+	}
+	batcher.Flush();
+	publish(pending);
+}
+
+void SceneLoader::uploadTextures(const std::vector<VulkanImage::Source>& materialTextures) {
+	mState = State::LoadingTextures;
+	mMeshCount = (uint32_t)materialTextures.size();
+	mMeshesDone = 0;
+
+	//Decoding runs in parallel inside AddMany, the coarse mips of all textures go out with a single submission
+	std::vector<TextureStreamer::Handle> handles = mTextures->AddMany(materialTextures);
+	mMeshesDone = (uint32_t)materialTextures.size();
+
+	std::lock_guard<std::mutex> lock(mLoadedMutex);
+	mMaterialTextures = std::move(handles);
+	mMaterialTexturesReady = true;
+}
+
+std::vector<VulkanImage::Source> SceneLoader::getMaterialTextures(const aiScene* scene, const std::string& scenePath) {
+	std::filesystem::path directory = std::filesystem::path(scenePath).parent_path();
+	std::vector<VulkanImage::Source> textures(scene->mNumMaterials);
+	for (uint32_t i = 0; i < scene->mNumMaterials; i++) {
+		const aiMaterial* material = scene->mMaterials[i];
+		aiString path;
+		if (material->GetTexture(aiTextureType_DIFFUSE, 0, &path) != aiReturn_SUCCESS) continue;
+		//Embedded textures ("*0") are not supported
+		if (path.length == 0 || path.data[0] == '*') continue;
+
+		std::string file = path.C_Str();
+		std::replace(file.begin(), file.end(), '\\', '/');
+		//Loaded as plain Color: the scene pipeline has no blending or alpha test yet, premultiplying would only darken the
+		//transparent texels. Switch cut out and blended materials to PremultipliedColor once one of them exists
+		textures[i].filename = (directory / file).generic_string();
+	}
+	return textures;
+}
+
+void SceneLoader::publish(std::vector<Mesh*>& meshes) {
+	mMeshesDone += (uint32_t)meshes.size();
+
+	std::lock_guard<std::mutex> lock(mLoadedMutex);
+	mLoaded.insert(mLoaded.end(), meshes.begin(), meshes.end());
+	meshes.clear();
+}
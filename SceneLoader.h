@@ -0,0 +1,84 @@
+#pragma once
+
+#include "GraphicsVulkan.h"
+#include "GeometryPool.h"
+#include "Mesh.h"
+#include "TextureStreamer.h"
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+	Imports and uploads a scene on a background thread, so the render loop keeps presenting frames.
+	Meshes are handed out in batches once their upload fence signalled, the render thread picks them up
+	with CollectLoaded() and owns them afterwards. The diffuse textures of all materials are added to the
+	texture streamer as one batch once the geometry is uploaded.
+*/
+class SceneLoader {
+public:
+	enum class State {
+		Idle,
+		Importing,
+		Processing,
+		Uploading,
+		LoadingTextures,
+		Done,
+		Failed
+	};
+
+public:
+	SceneLoader(const GraphicsVulkan& gfx, GeometryPool& pool, TextureStreamer& textures);
+	/* Cancels a running load and waits for the thread */
+	~SceneLoader();
+	SceneLoader(const SceneLoader&) = delete;
+	SceneLoader& operator=(const SceneLoader&) = delete;
+
+	/* Starts loading, the cache is used if it is still valid and rewritten otherwise */
+	void Load(const std::string& scenePath, const std::string& cachePath);
+	/* Appends the meshes that finished since the last call */
+	void CollectLoaded(std::vector<Mesh*>& outMeshes);
+	/* Textures indexed by Mesh::GetMaterialIndex(), INVALID_HANDLE for materials without one. False until they are added */
+	bool CollectMaterialTextures(std::vector<TextureStreamer::Handle>& outTextures);
+
+	State GetState() const {
+		return mState;
+	}
+	bool IsLoading() const {
+		State state = mState;
+		return state != State::Idle && state != State::Done && state != State::Failed;
+	}
+	/* Fraction of the current stage, importing has no progress */
+	float GetProgress() const;
+	const char* GetStateName() const;
+
+private:
+	//Published meshes are batched by upload size, so a fence wait is not paid per mesh
+	const vk::DeviceSize PUBLISH_BATCH_SIZE = 4 * 1024 * 1024;
+	const vk::DeviceSize STAGING_SIZE = 16 * 1024 * 1024;
+
+	void loadScene(const std::string& scenePath, const std::string& cachePath);
+	void uploadMeshes(const std::vector<Mesh::Geometry>& geometry);
+	void uploadTextures(const std::vector<VulkanImage::Source>& materialTextures);
+	void publish(std::vector<Mesh*>& meshes);
+
+	static std::vector<VulkanImage::Source> getMaterialTextures(const aiScene* scene, const std::string& scenePath);
+
+private:
+	const GraphicsVulkan* mGfx;
+	GeometryPool* mPool;
+	TextureStreamer* mTextures;
+
+	std::thread mThread;
+	std::atomic<State> mState{ State::Idle };
+	std::atomic<bool> mCancel{ false };
+	std::atomic<uint32_t> mMeshCount{ 0 };
+	std::atomic<uint32_t> mMeshesDone{ 0 };
+
+	std::mutex mLoadedMutex;
+	std::vector<Mesh*> mLoaded;
+	std::vector<TextureStreamer::Handle> mMaterialTextures;
+	bool mMaterialTexturesReady = false;
+};
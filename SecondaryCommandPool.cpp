@@ -0,0 +1,38 @@
+#include "SecondaryCommandPool.h"
+
+SecondaryCommandPool::SecondaryCommandPool(const GraphicsVulkan& gfx, uint32_t slotCount) {
+	mDevice = gfx.mDevice;
+	mSlotCount = slotCount;
+
+	//Transient, the buffers are rerecorded every frame
+	vk::CommandPoolCreateInfo poolInfo{ vk::CommandPoolCreateFlagBits::eTransient, gfx.mQueueFamilyIndices.graphicsFamily.value() };
+	mSlots.resize(gfx.MAX_FRAMES_IN_FLIGHT * slotCount);
+	for (Slot& slot : mSlots) slot.pool = mDevice.createCommandPool(poolInfo);
+}
+
+SecondaryCommandPool::~SecondaryCommandPool() {
+	//Buffers are freed with their pool
+	for (Slot& slot : mSlots) mDevice.destroyCommandPool(slot.pool);
+}
+
+void SecondaryCommandPool::BeginFrame(uint32_t frameIndex) {
+	mFrameIndex = frameIndex;
+	for (uint32_t i = 0; i < mSlotCount; i++) {
+		Slot& slot = mSlots[frameIndex * mSlotCount + i];
+		if (slot.used == 0) continue;
+		mDevice.resetCommandPool(slot.pool, {});
+		slot.used = 0;
+	}
+}
+
+vk::CommandBuffer SecondaryCommandPool::Begin(uint32_t slot, const vk::CommandBufferInheritanceInfo& inheritance) {
+	Slot& current = mSlots[mFrameIndex * mSlotCount + slot];
+	if (current.used == current.buffers.size()) {
+		vk::CommandBufferAllocateInfo allocateInfo{ current.pool, vk::CommandBufferLevel::eSecondary, 1 };
+		current.buffers.push_back(mDevice.allocateCommandBuffers(allocateInfo)[0]);
+	}
+
+	vk::CommandBuffer buffer = current.buffers[current.used++];
+	buffer.begin(vk::CommandBufferBeginInfo{ vk::CommandBufferUsageFlagBits::eOneTimeSubmit | vk::CommandBufferUsageFlagBits::eRenderPassContinue, &inheritance });
+	return buffer;
+}
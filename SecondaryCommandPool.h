@@ -0,0 +1,44 @@
+#pragma once
+
+#include "GraphicsVulkan.h"
+
+#include <vector>
+
+/*
+	Secondary command buffers for recording one render pass from several threads at once.
+	A command pool may only be used by one thread at a time, so every recording slot has its own pool,
+	and every frame in flight its own set of slots. All pools of a frame are reset together once
+	the fence of that frame was waited, their buffers are reused instead of freed.
+*/
+class SecondaryCommandPool {
+public:
+	SecondaryCommandPool(const GraphicsVulkan& gfx, uint32_t slotCount);
+	~SecondaryCommandPool();
+	SecondaryCommandPool(const SecondaryCommandPool&) = delete;
+	SecondaryCommandPool& operator=(const SecondaryCommandPool&) = delete;
+
+	/* Render thread. Starts reusing the buffers of frameIndex, the GPU has to be done with that frame */
+	void BeginFrame(uint32_t frameIndex);
+	/*
+		Returns a buffer of the current frame, begun to continue the render pass of inheritance.
+		Any thread, but only one thread per slot at a time.
+	*/
+	vk::CommandBuffer Begin(uint32_t slot, const vk::CommandBufferInheritanceInfo& inheritance);
+
+	uint32_t GetSlotCount() const {
+		return mSlotCount;
+	}
+
+private:
+	struct Slot {
+		vk::CommandPool pool;
+		std::vector<vk::CommandBuffer> buffers;
+		uint32_t used = 0;
+	};
+
+private:
+	vk::Device mDevice;
+	uint32_t mSlotCount;
+	std::vector<Slot> mSlots; //frame * mSlotCount + slot
+	uint32_t mFrameIndex = 0;
+};
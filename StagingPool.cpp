@@ -0,0 +1,111 @@
+#include "StagingPool.h"
+
+#include <algorithm>
+
+StagingPool::StagingPool(vk::Device device, MemoryAllocator& allocator) {
+	mDevice = device;
+	mAllocator = &allocator;
+}
+
+StagingPool::~StagingPool() {
+	for (Buffer& buffer : mIdle) {
+		if (buffer.submitted) mDevice.waitForFences(buffer.fence, VK_TRUE, UINT64_MAX);
+		destroy(buffer);
+	}
+}
+
+StagingPool::Buffer StagingPool::Acquire(vk::DeviceSize size) {
+	vk::DeviceSize classSize = MIN_CLASS_SIZE;
+	while (classSize < size) classSize *= 2;
+
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mStats.acquires++;
+		mStats.inUseSize += classSize;
+		mStats.highWaterMark = std::max(mStats.highWaterMark, mStats.inUseSize);
+		for (size_t i = 0; i < mIdle.size(); i++) {
+			if (mIdle[i].size != classSize || !isIdle(mIdle[i])) continue;
+			Buffer buffer = mIdle[i];
+			mIdle.erase(mIdle.begin() + i);
+			mIdleSize -= classSize;
+			mStats.reuses++;
+			return buffer;
+		}
+		mStats.pooledSize += classSize;
+		mStats.bufferCount++;
+	}
+
+	//Created outside the lock, other threads can keep reusing buffers meanwhile
+	Buffer buffer;
+	buffer.size = classSize;
+	mAllocator->CreateBuffer(classSize, vk::BufferUsageFlagBits::eTransferSrc, vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+		MemoryAllocator::Category::Staging, buffer.buffer, buffer.allocation);
+	buffer.data = buffer.allocation.mapped;
+	buffer.fence = mDevice.createFence({});
+	return buffer;
+}
+
+void StagingPool::Release(Buffer& buffer) {
+	if (!buffer.buffer) return;
+
+	bool keep;
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mStats.inUseSize -= buffer.size;
+		keep = mIdleSize + buffer.size <= MAX_IDLE_SIZE;
+		if (keep) {
+			buffer.releasedAt = mTrimCount;
+			mIdle.push_back(buffer);
+			mIdleSize += buffer.size;
+		} else {
+			mStats.pooledSize -= buffer.size;
+			mStats.bufferCount--;
+		}
+	}
+
+	//The fence wait happens outside the lock, so other uploads are not blocked by it
+	if (!keep) {
+		if (buffer.submitted) mDevice.waitForFences(buffer.fence, VK_TRUE, UINT64_MAX);
+		destroy(buffer);
+	}
+	buffer = Buffer{};
+}
+
+void StagingPool::Trim() {
+	std::vector<Buffer> expired;
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mTrimCount++;
+		for (size_t i = 0; i < mIdle.size();) {
+			if (mTrimCount - mIdle[i].releasedAt < MAX_IDLE_TRIMS || !isIdle(mIdle[i])) {
+				i++;
+				continue;
+			}
+			mIdleSize -= mIdle[i].size;
+			mStats.pooledSize -= mIdle[i].size;
+			mStats.bufferCount--;
+			expired.push_back(mIdle[i]);
+			mIdle.erase(mIdle.begin() + i);
+		}
+	}
+	for (Buffer& buffer : expired) destroy(buffer);
+}
+
+StagingPool::Stats StagingPool::GetStats() const {
+	std::lock_guard<std::mutex> lock(mMutex);
+	return mStats;
+}
+
+bool StagingPool::isIdle(Buffer& buffer) {
+	if (!buffer.submitted) return true;
+	if (mDevice.getFenceStatus(buffer.fence) != vk::Result::eSuccess) return false;
+
+	mDevice.resetFences(buffer.fence);
+	buffer.submitted = false;
+	return true;
+}
+
+void StagingPool::destroy(Buffer& buffer) {
+	mDevice.destroyFence(buffer.fence);
+	mAllocator->DestroyBuffer(buffer.buffer, buffer.allocation);
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "MemoryAllocator.h"
+
+#include <mutex>
+#include <vector>
+
+/*
+	Host visible staging buffers that are reused across uploads instead of being created and destroyed for each one.
+	Buffers come in power of two size classes. Every buffer has its own fence, a buffer released while the copies
+	reading it may still run is only handed out again after that fence signaled.
+	Thread safe, shared by all upload batchers.
+*/
+class StagingPool {
+public:
+	struct Buffer {
+		vk::Buffer buffer;
+		uint8_t* data = nullptr;  //persistently mapped
+		vk::DeviceSize size = 0;  //size of the class, at least what was asked for
+		vk::Fence fence;          //unsignaled when acquired, the submission reading the buffer signals it
+		bool submitted = false;   //set by the owner once the fence went to a submission
+		uint64_t releasedAt = 0;  //Trim calls so far when the buffer was released
+		MemoryAllocator::Allocation allocation;
+	};
+	struct Stats {
+		vk::DeviceSize pooledSize;    //every buffer the pool owns, idle or not
+		vk::DeviceSize inUseSize;     //acquired and not released yet
+		vk::DeviceSize highWaterMark; //highest inUseSize so far
+		uint32_t bufferCount;
+		uint64_t acquires;
+		uint64_t reuses;              //acquires served without creating a buffer
+	};
+
+public:
+	StagingPool(vk::Device device, MemoryAllocator& allocator);
+	/* Waits for buffers still in flight, acquired ones have to be released before */
+	~StagingPool();
+	StagingPool(const StagingPool&) = delete;
+	StagingPool& operator=(const StagingPool&) = delete;
+
+	Buffer Acquire(vk::DeviceSize size);
+	/* Gives the buffer back, it may still be read by its submission */
+	void Release(Buffer& buffer);
+	/* Once per frame. Frees buffers that finished and were not reused for MAX_IDLE_TRIMS calls */
+	void Trim();
+	Stats GetStats() const;
+
+private:
+	const vk::DeviceSize MIN_CLASS_SIZE = 64 * 1024;
+	//Idle buffers beyond this are freed on release, so one huge upload does not keep its memory forever
+	const vk::DeviceSize MAX_IDLE_SIZE = 64 * 1024 * 1024;
+	//About two seconds of frames, uploads that come in bursts keep their buffers in between
+	const uint64_t MAX_IDLE_TRIMS = 120;
+
+	/* True if no submission reads the buffer anymore, resets a signaled fence. mMutex has to be held */
+	bool isIdle(Buffer& buffer);
+	void destroy(Buffer& buffer);
+
+private:
+	vk::Device mDevice;
+	MemoryAllocator* mAllocator;
+
+	mutable std::mutex mMutex;
+	std::vector<Buffer> mIdle; //released buffers, the ones still in flight wait for their fence
+	vk::DeviceSize mIdleSize = 0;
+	uint64_t mTrimCount = 0;
+	Stats mStats{};
+};
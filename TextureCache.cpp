@@ -0,0 +1,47 @@
+#include "TextureCache.h"
+
+#include "FileUtils.h"
+
+#include <cctype>
+#include <filesystem>
+
+TextureCache::TextureCache(const GraphicsVulkan& gfx) {
+	mGfx = &gfx;
+}
+
+std::shared_ptr<VulkanImage> TextureCache::Get(const std::string& filename) {
+	return get(filename, nullptr);
+}
+
+std::shared_ptr<VulkanImage> TextureCache::Get(const std::string& filename, UploadBatcher& batcher) {
+	return get(filename, &batcher);
+}
+
+std::string TextureCache::NormalizePath(const std::string& filename) {
+	std::error_code error;
+	std::filesystem::path path = std::filesystem::absolute(filename, error);
+	if (error) path = filename;
+	std::string normalized = path.lexically_normal().generic_string();
+#ifdef _WIN32
+	//Paths are case insensitive on Windows
+	for (char& c : normalized) c = (char)tolower((unsigned char)c);
+#endif
+	return normalized;
+}
+
+std::shared_ptr<VulkanImage> TextureCache::get(const std::string& filename, UploadBatcher* batcher) {
+	std::shared_ptr<Slot> pathSlot = getSlot(mPathSlots, NormalizePath(filename));
+	std::lock_guard<std::mutex> pathLock(pathSlot->mutex);
+	if (std::shared_ptr<VulkanImage> image = pathSlot->image.lock()) return image;
+
+	//Path slots are always locked before hash slots, so two loads can never wait on each other
+	std::shared_ptr<Slot> hashSlot = getSlot(mHashSlots, FileUtils::hashFile(filename));
+	std::lock_guard<std::mutex> hashLock(hashSlot->mutex);
+	std::shared_ptr<VulkanImage> image = hashSlot->image.lock();
+	if (!image) {
+		image = batcher ? std::make_shared<VulkanImage>(*mGfx, filename, *batcher) : std::make_shared<VulkanImage>(*mGfx, filename);
+		hashSlot->image = image;
+	}
+	pathSlot->image = image;
+	return image;
+}
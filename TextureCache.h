@@ -0,0 +1,53 @@
+#pragma once
+
+#include "GraphicsVulkan.h"
+#include "UploadBatcher.h"
+#include "VulkanImage.h"
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+/*
+	Hands out shared images, so every file is decoded and resident only once no matter how many
+	materials use it. Images are found by normalized path first and by content hash second, which also
+	catches copies of the same file. The cache only holds weak references, an image is released with its last user.
+*/
+class TextureCache {
+public:
+	TextureCache(const GraphicsVulkan& gfx);
+	TextureCache(const TextureCache&) = delete;
+	TextureCache& operator=(const TextureCache&) = delete;
+
+	/* Loads and uploads on first use, thread safe */
+	std::shared_ptr<VulkanImage> Get(const std::string& filename);
+	/* Upload of a new image is only recorded, it is ready after batcher.Flush() */
+	std::shared_ptr<VulkanImage> Get(const std::string& filename, UploadBatcher& batcher);
+
+	static std::string NormalizePath(const std::string& filename);
+
+private:
+	//Loads of one image are serialized on its slot, different images can load in parallel
+	struct Slot {
+		std::mutex mutex;
+		std::weak_ptr<VulkanImage> image;
+	};
+
+	template<typename Key>
+	std::shared_ptr<Slot> getSlot(std::unordered_map<Key, std::shared_ptr<Slot>>& slots, const Key& key) {
+		std::lock_guard<std::mutex> lock(mMutex);
+		std::shared_ptr<Slot>& slot = slots[key];
+		if (!slot) slot = std::make_shared<Slot>();
+		return slot;
+	}
+
+	std::shared_ptr<VulkanImage> get(const std::string& filename, UploadBatcher* batcher);
+
+private:
+	const GraphicsVulkan* mGfx;
+
+	std::mutex mMutex;
+	std::unordered_map<std::string, std::shared_ptr<Slot>> mPathSlots;
+	std::unordered_map<uint64_t, std::shared_ptr<Slot>> mHashSlots;
+};
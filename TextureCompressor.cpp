@@ -0,0 +1,465 @@
+#include "TextureCompressor.h"
+
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+#if defined(_M_X64) || defined(__SSE2__)
+#define NOU_TEXTURE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace TextureCompressor {
+
+	namespace {
+		//Interpolation weights of 4 bit BC7 indices, out of 64
+		const int BC7_WEIGHTS[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+		void loadBlock(const uint8_t* rgba, uint32_t width, uint32_t height, uint32_t blockX, uint32_t blockY, uint8_t* outBlock) {
+			for (uint32_t y = 0; y < 4; y++) {
+				uint32_t sourceY = std::min(blockY * 4 + y, height - 1);
+				for (uint32_t x = 0; x < 4; x++) {
+					uint32_t sourceX = std::min(blockX * 4 + x, width - 1);
+					memcpy(&outBlock[(y * 4 + x) * 4], &rgba[((size_t)sourceY * width + sourceX) * 4], 4);
+				}
+			}
+		}
+
+		/*
+			Picks the nearest palette entry for all 16 texels and returns the summed squared RGBA error.
+			paletteSize has to be even.
+		*/
+		uint32_t selectIndices(const uint8_t* texels, const uint8_t* palette, int paletteSize, uint8_t* outIndices) {
+			uint32_t totalError = 0;
+#ifdef NOU_TEXTURE_SSE2
+			//Two palette entries per register in 16 bit lanes, madd squares and sums neighbouring channels
+			__m128i zero = _mm_setzero_si128();
+			__m128i pairs[8];
+			for (int p = 0; p < paletteSize; p += 2) {
+				pairs[p / 2] = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)&palette[p * 4]), zero);
+			}
+
+			for (int i = 0; i < 16; i++) {
+				int32_t packed;
+				memcpy(&packed, &texels[i * 4], sizeof(packed));
+				__m128i texel = _mm_unpacklo_epi8(_mm_cvtsi32_si128(packed), zero);
+				texel = _mm_unpacklo_epi64(texel, texel);
+
+				uint32_t bestError = UINT32_MAX;
+				uint8_t bestIndex = 0;
+				for (int p = 0; p < paletteSize / 2; p++) {
+					__m128i diff = _mm_sub_epi16(texel, pairs[p]);
+					__m128i squares = _mm_madd_epi16(diff, diff);
+					__m128i sums = _mm_add_epi32(squares, _mm_shuffle_epi32(squares, _MM_SHUFFLE(2, 3, 0, 1)));
+					uint32_t error0 = (uint32_t)_mm_cvtsi128_si32(sums);
+					uint32_t error1 = (uint32_t)_mm_cvtsi128_si32(_mm_srli_si128(sums, 8));
+					if (error0 < bestError) {
+						bestError = error0;
+						bestIndex = (uint8_t)(p * 2);
+					}
+					if (error1 < bestError) {
+						bestError = error1;
+						bestIndex = (uint8_t)(p * 2 + 1);
+					}
+				}
+				outIndices[i] = bestIndex;
+				totalError += bestError;
+			}
+#else
+			for (int i = 0; i < 16; i++) {
+				uint32_t bestError = UINT32_MAX;
+				uint8_t bestIndex = 0;
+				for (int p = 0; p < paletteSize; p++) {
+					uint32_t error = 0;
+					for (int c = 0; c < 4; c++) {
+						int diff = (int)texels[i * 4 + c] - (int)palette[p * 4 + c];
+						error += diff * diff;
+					}
+					if (error < bestError) {
+						bestError = error;
+						bestIndex = (uint8_t)p;
+					}
+				}
+				outIndices[i] = bestIndex;
+				totalError += bestError;
+			}
+#endif
+			return totalError;
+		}
+
+		/* Principal axis of the first channelCount channels by power iteration, false if the block is uniform */
+		bool principalAxis(const uint8_t* texels, int channelCount, float* outMean, float* outAxis) {
+			for (int c = 0; c < 4; c++) {
+				outMean[c] = 0.0f;
+				outAxis[c] = 0.0f;
+			}
+			for (int i = 0; i < 16; i++) {
+				for (int c = 0; c < channelCount; c++) outMean[c] += texels[i * 4 + c];
+			}
+			for (int c = 0; c < channelCount; c++) outMean[c] /= 16.0f;
+
+			float covariance[4][4] = {};
+			for (int i = 0; i < 16; i++) {
+				float d[4];
+				for (int c = 0; c < channelCount; c++) d[c] = texels[i * 4 + c] - outMean[c];
+				for (int a = 0; a < channelCount; a++) {
+					for (int b = 0; b < channelCount; b++) covariance[a][b] += d[a] * d[b];
+				}
+			}
+
+			//Start at the channel with the largest spread, its covariance row already points roughly the right way
+			int largest = 0;
+			for (int c = 1; c < channelCount; c++) {
+				if (covariance[c][c] > covariance[largest][largest]) largest = c;
+			}
+			if (covariance[largest][largest] <= 0.0f) return false;
+
+			float axis[4] = {};
+			for (int c = 0; c < channelCount; c++) axis[c] = covariance[largest][c];
+			for (int iteration = 0; iteration < 8; iteration++) {
+				float next[4] = {};
+				float maxComponent = 0.0f;
+				for (int a = 0; a < channelCount; a++) {
+					for (int b = 0; b < channelCount; b++) next[a] += covariance[a][b] * axis[b];
+					maxComponent = std::max(maxComponent, std::fabs(next[a]));
+				}
+				if (maxComponent == 0.0f) return false;
+				for (int c = 0; c < channelCount; c++) axis[c] = next[c] / maxComponent;
+			}
+
+			float length = 0.0f;
+			for (int c = 0; c < channelCount; c++) length += axis[c] * axis[c];
+			length = std::sqrt(length);
+			if (length == 0.0f) return false;
+			for (int c = 0; c < channelCount; c++) outAxis[c] = axis[c] / length;
+			return true;
+		}
+
+		/* Extent of the texels along the axis, relative to the mean */
+		void projectOnAxis(const uint8_t* texels, int channelCount, const float* mean, const float* axis, float& outMin, float& outMax) {
+			outMin = FLT_MAX;
+			outMax = -FLT_MAX;
+			for (int i = 0; i < 16; i++) {
+				float t = 0.0f;
+				for (int c = 0; c < channelCount; c++) t += (texels[i * 4 + c] - mean[c]) * axis[c];
+				outMin = std::min(outMin, t);
+				outMax = std::max(outMax, t);
+			}
+		}
+
+		uint16_t packRGB565(const float* color) {
+			int r = std::clamp((int)(color[0] * 31.0f / 255.0f + 0.5f), 0, 31);
+			int g = std::clamp((int)(color[1] * 63.0f / 255.0f + 0.5f), 0, 63);
+			int b = std::clamp((int)(color[2] * 31.0f / 255.0f + 0.5f), 0, 31);
+			return (uint16_t)((r << 11) | (g << 5) | b);
+		}
+
+		void unpackRGB565(uint16_t color, uint8_t* outRgba) {
+			uint32_t r = (color >> 11) & 31;
+			uint32_t g = (color >> 5) & 63;
+			uint32_t b = color & 31;
+			outRgba[0] = (uint8_t)((r << 3) | (r >> 2));
+			outRgba[1] = (uint8_t)((g << 2) | (g >> 4));
+			outRgba[2] = (uint8_t)((b << 3) | (b >> 2));
+			outRgba[3] = 255;
+		}
+
+		//BC1 color block, always in four color mode so it can be reused for BC3
+		void encodeColorBlock(const uint8_t* block, uint8_t* destination) {
+			//Alpha is not part of the fit, it would only disturb the distances
+			uint8_t texels[64];
+			for (int i = 0; i < 16; i++) {
+				memcpy(&texels[i * 4], &block[i * 4], 3);
+				texels[i * 4 + 3] = 255;
+			}
+
+			float mean[4];
+			float axis[4];
+			uint16_t color0;
+			uint16_t color1;
+			if (!principalAxis(texels, 3, mean, axis)) {
+				color0 = color1 = packRGB565(mean);
+			} else {
+				float minT;
+				float maxT;
+				projectOnAxis(texels, 3, mean, axis, minT, maxT);
+				//Inset the endpoints, the extremes are hardly ever hit exactly after quantization
+				float inset = (maxT - minT) / 16.0f;
+				minT += inset;
+				maxT -= inset;
+
+				float end0[3];
+				float end1[3];
+				for (int c = 0; c < 3; c++) {
+					end0[c] = mean[c] + axis[c] * maxT;
+					end1[c] = mean[c] + axis[c] * minT;
+				}
+				color0 = packRGB565(end0);
+				color1 = packRGB565(end1);
+			}
+			if (color0 < color1) std::swap(color0, color1);
+
+			uint32_t indexBits = 0;
+			if (color0 != color1) {
+				uint8_t palette[16];
+				unpackRGB565(color0, &palette[0]);
+				unpackRGB565(color1, &palette[4]);
+				for (int c = 0; c < 3; c++) {
+					palette[8 + c] = (uint8_t)((2 * palette[c] + palette[4 + c] + 1) / 3);
+					palette[12 + c] = (uint8_t)((palette[c] + 2 * palette[4 + c] + 1) / 3);
+				}
+				palette[11] = palette[15] = 255;
+
+				uint8_t indices[16];
+				selectIndices(texels, palette, 4, indices);
+				for (int i = 0; i < 16; i++) indexBits |= (uint32_t)indices[i] << (i * 2);
+			}
+
+			destination[0] = (uint8_t)(color0 & 0xFF);
+			destination[1] = (uint8_t)(color0 >> 8);
+			destination[2] = (uint8_t)(color1 & 0xFF);
+			destination[3] = (uint8_t)(color1 >> 8);
+			for (int b = 0; b < 4; b++) destination[4 + b] = (uint8_t)(indexBits >> (b * 8));
+		}
+
+		//BC4 block of a single channel, in eight value mode
+		void encodeChannelBlock(const uint8_t* block, int channel, uint8_t* destination) {
+			uint8_t minValue = 255;
+			uint8_t maxValue = 0;
+			for (int i = 0; i < 16; i++) {
+				minValue = std::min(minValue, block[i * 4 + channel]);
+				maxValue = std::max(maxValue, block[i * 4 + channel]);
+			}
+
+			uint64_t indexBits = 0;
+			if (minValue != maxValue) {
+				int palette[8] = { maxValue, minValue };
+				for (int k = 2; k < 8; k++) palette[k] = ((8 - k) * maxValue + (k - 1) * minValue + 3) / 7;
+
+				for (int i = 0; i < 16; i++) {
+					int value = block[i * 4 + channel];
+					int bestIndex = 0;
+					int bestError = INT32_MAX;
+					for (int k = 0; k < 8; k++) {
+						int error = std::abs(value - palette[k]);
+						if (error < bestError) {
+							bestError = error;
+							bestIndex = k;
+						}
+					}
+					indexBits |= (uint64_t)bestIndex << (i * 3);
+				}
+			}
+
+			destination[0] = maxValue;
+			destination[1] = minValue;
+			for (int b = 0; b < 6; b++) destination[2 + b] = (uint8_t)(indexBits >> (b * 8));
+		}
+
+		//Little endian bit stream over a 16 byte block
+		class BitWriter {
+		public:
+			BitWriter(uint8_t* destination) :
+				mDestination(destination) {
+				memset(destination, 0, 16);
+			}
+			void Write(uint32_t value, uint32_t bitCount) {
+				for (uint32_t i = 0; i < bitCount; i++, mPosition++) {
+					if (value & (1u << i)) mDestination[mPosition >> 3] |= (uint8_t)(1 << (mPosition & 7));
+				}
+			}
+
+		private:
+			uint8_t* mDestination;
+			uint32_t mPosition = 0;
+		};
+	}
+
+	uint32_t getBlockSize(BlockFormat format) {
+		return format == BlockFormat::BC1 ? 8 : 16;
+	}
+
+	size_t getCompressedSize(BlockFormat format, uint32_t width, uint32_t height) {
+		return (size_t)((width + 3) / 4) * ((height + 3) / 4) * getBlockSize(format);
+	}
+
+	BlockFormat chooseFormat(const uint8_t* rgba, uint32_t width, uint32_t height) {
+		size_t texelCount = (size_t)width * height;
+		bool opaque = true;
+		for (size_t i = 0; i < texelCount; i++) {
+			uint8_t alpha = rgba[i * 4 + 3];
+			if (alpha == 255) continue;
+			if (alpha != 0) return BlockFormat::BC7;
+			opaque = false;
+		}
+		return opaque ? BlockFormat::BC1 : BlockFormat::BC3;
+	}
+
+	void encodeBlockBC1(const uint8_t* block, uint8_t* destination) {
+		encodeColorBlock(block, destination);
+	}
+
+	void encodeBlockBC3(const uint8_t* block, uint8_t* destination) {
+		encodeChannelBlock(block, 3, destination);
+		encodeColorBlock(block, destination + 8);
+	}
+
+	void encodeBlockBC5(const uint8_t* block, uint8_t* destination) {
+		encodeChannelBlock(block, 0, destination);
+		encodeChannelBlock(block, 1, destination + 8);
+	}
+
+	void encodeBlockBC7(const uint8_t* block, uint8_t* destination) {
+		//Mode 6: one subset, 7 bit RGBA endpoints with a shared low bit each, 4 bit indices
+		float mean[4];
+		float axis[4];
+		float end0[4];
+		float end1[4];
+		if (!principalAxis(block, 4, mean, axis)) {
+			std::copy(mean, mean + 4, end0);
+			std::copy(mean, mean + 4, end1);
+		} else {
+			float minT;
+			float maxT;
+			projectOnAxis(block, 4, mean, axis, minT, maxT);
+			for (int c = 0; c < 4; c++) {
+				end0[c] = mean[c] + axis[c] * minT;
+				end1[c] = mean[c] + axis[c] * maxT;
+			}
+		}
+
+		uint32_t bestError = UINT32_MAX;
+		int bestEndpoints[2][4] = {};
+		int bestBits[2] = {};
+		uint8_t bestIndices[16] = {};
+		for (int bits = 0; bits < 4; bits++) {
+			int pBits[2] = { bits & 1, bits >> 1 };
+			int endpoints[2][4];
+			uint8_t expanded[2][4];
+			for (int c = 0; c < 4; c++) {
+				endpoints[0][c] = std::clamp((int)std::lround((end0[c] - pBits[0]) * 0.5f), 0, 127);
+				endpoints[1][c] = std::clamp((int)std::lround((end1[c] - pBits[1]) * 0.5f), 0, 127);
+				expanded[0][c] = (uint8_t)((endpoints[0][c] << 1) | pBits[0]);
+				expanded[1][c] = (uint8_t)((endpoints[1][c] << 1) | pBits[1]);
+			}
+
+			uint8_t palette[64];
+			for (int k = 0; k < 16; k++) {
+				for (int c = 0; c < 4; c++) {
+					palette[k * 4 + c] = (uint8_t)(((64 - BC7_WEIGHTS[k]) * expanded[0][c] + BC7_WEIGHTS[k] * expanded[1][c] + 32) >> 6);
+				}
+			}
+
+			uint8_t indices[16];
+			uint32_t error = selectIndices(block, palette, 16, indices);
+			if (error < bestError) {
+				bestError = error;
+				memcpy(bestEndpoints, endpoints, sizeof(endpoints));
+				std::copy(pBits, pBits + 2, bestBits);
+				std::copy(indices, indices + 16, bestIndices);
+			}
+		}
+
+		//The first index is stored without its top bit, swapping the endpoints mirrors the weights
+		if (bestIndices[0] >= 8) {
+			for (int c = 0; c < 4; c++) std::swap(bestEndpoints[0][c], bestEndpoints[1][c]);
+			std::swap(bestBits[0], bestBits[1]);
+			for (int i = 0; i < 16; i++) bestIndices[i] = (uint8_t)(15 - bestIndices[i]);
+		}
+
+		BitWriter writer(destination);
+		writer.Write(1 << 6, 7);
+		for (int c = 0; c < 4; c++) {
+			writer.Write(bestEndpoints[0][c], 7);
+			writer.Write(bestEndpoints[1][c], 7);
+		}
+		writer.Write(bestBits[0], 1);
+		writer.Write(bestBits[1], 1);
+		writer.Write(bestIndices[0], 3);
+		for (int i = 1; i < 16; i++) writer.Write(bestIndices[i], 4);
+	}
+
+	void compress(BlockFormat format, const uint8_t* rgba, uint32_t width, uint32_t height, uint8_t* destination) {
+		uint32_t blocksX = (width + 3) / 4;
+		uint32_t blocksY = (height + 3) / 4;
+		uint32_t blockSize = getBlockSize(format);
+
+		void (*encodeBlock)(const uint8_t*, uint8_t*) = encodeBlockBC1;
+		switch (format) {
+		case BlockFormat::BC1: encodeBlock = encodeBlockBC1; break;
+		case BlockFormat::BC3: encodeBlock = encodeBlockBC3; break;
+		case BlockFormat::BC5: encodeBlock = encodeBlockBC5; break;
+		case BlockFormat::BC7: encodeBlock = encodeBlockBC7; break;
+		}
+
+		ThreadPool::Shared().ParallelFor(blocksY, [&](uint32_t blockY) {
+			uint8_t block[64];
+			for (uint32_t blockX = 0; blockX < blocksX; blockX++) {
+				loadBlock(rgba, width, height, blockX, blockY, block);
+				encodeBlock(block, destination + ((size_t)blockY * blocksX + blockX) * blockSize);
+			}
+		});
+	}
+
+	void downsample(const uint8_t* rgba, uint32_t width, uint32_t height, std::vector<uint8_t>& outRgba) {
+		uint32_t outWidth = std::max(width / 2, 1u);
+		uint32_t outHeight = std::max(height / 2, 1u);
+		outRgba.resize((size_t)outWidth * outHeight * 4);
+
+		for (uint32_t y = 0; y < outHeight; y++) {
+			const uint8_t* row0 = &rgba[(size_t)std::min(y * 2, height - 1) * width * 4];
+			const uint8_t* row1 = &rgba[(size_t)std::min(y * 2 + 1, height - 1) * width * 4];
+			uint8_t* out = &outRgba[(size_t)y * outWidth * 4];
+
+			uint32_t x = 0;
+#ifdef NOU_TEXTURE_SSE2
+			//Two output texels from four source texels of both rows per step
+			__m128i zero = _mm_setzero_si128();
+			__m128i rounding = _mm_set1_epi16(2);
+			for (; x + 1 < outWidth && x * 2 + 3 < width; x += 2) {
+				__m128i top = _mm_loadu_si128((const __m128i*)&row0[x * 8]);
+				__m128i bottom = _mm_loadu_si128((const __m128i*)&row1[x * 8]);
+				__m128i low = _mm_add_epi16(_mm_unpacklo_epi8(top, zero), _mm_unpacklo_epi8(bottom, zero));
+				__m128i high = _mm_add_epi16(_mm_unpackhi_epi8(top, zero), _mm_unpackhi_epi8(bottom, zero));
+				low = _mm_add_epi16(low, _mm_srli_si128(low, 8));
+				high = _mm_add_epi16(high, _mm_srli_si128(high, 8));
+				__m128i sum = _mm_srli_epi16(_mm_add_epi16(_mm_unpacklo_epi64(low, high), rounding), 2);
+				_mm_storel_epi64((__m128i*)&out[x * 4], _mm_packus_epi16(sum, zero));
+			}
+#endif
+			for (; x < outWidth; x++) {
+				uint32_t x0 = std::min(x * 2, width - 1);
+				uint32_t x1 = std::min(x * 2 + 1, width - 1);
+				for (int c = 0; c < 4; c++) {
+					out[x * 4 + c] = (uint8_t)((row0[x0 * 4 + c] + row0[x1 * 4 + c] + row1[x0 * 4 + c] + row1[x1 * 4 + c] + 2) >> 2);
+				}
+			}
+		}
+	}
+
+	void compressMipChain(BlockFormat format, const uint8_t* rgba, uint32_t width, uint32_t height, std::vector<uint8_t>& outData, std::vector<MipLevel>& outLevels) {
+		outData.clear();
+		outLevels.clear();
+
+		std::vector<uint8_t> current;
+		std::vector<uint8_t> next;
+		const uint8_t* level = rgba;
+		while (true) {
+			MipLevel mip{ width, height, outData.size(), getCompressedSize(format, width, height) };
+			outLevels.push_back(mip);
+			outData.resize(mip.offset + mip.size);
+			compress(format, level, width, height, &outData[mip.offset]);
+
+			if (width == 1 && height == 1) break;
+			downsample(level, width, height, next);
+			current.swap(next);
+			level = current.data();
+			width = std::max(width / 2, 1u);
+			height = std::max(height / 2, 1u);
+		}
+	}
+
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+/*
+	Block compression of RGBA8 images for direct upload. All formats work on 4x4 texel blocks,
+	sizes that are no multiple of 4 are padded by repeating the last row and column.
+	Blocks are passed as 16 RGBA texels in row order.
+*/
+namespace TextureCompressor {
+
+	enum class BlockFormat : uint32_t {
+		BC1 = 0, //RGB, 8 bytes per block
+		BC3 = 1, //RGBA, BC1 color plus BC4 alpha, 16 bytes per block
+		BC5 = 2, //RG in two BC4 channels, meant for normal maps, 16 bytes per block
+		BC7 = 3  //RGBA, mode 6 only, 16 bytes per block
+	};
+
+	struct MipLevel {
+		uint32_t width;
+		uint32_t height;
+		uint64_t offset;
+		uint64_t size;
+	};
+
+	uint32_t getBlockSize(BlockFormat format);
+	size_t getCompressedSize(BlockFormat format, uint32_t width, uint32_t height);
+	/*
+		BC1 for opaque images. BC3 for cut outs whose alpha is only 0 or 255, its own alpha block keeps the mask edges
+		exact where BC7 mode 6 shares its indices with color. BC7 for any other alpha.
+		Only looks at alpha, two channel data like normal maps is always BC5.
+	*/
+	BlockFormat chooseFormat(const uint8_t* rgba, uint32_t width, uint32_t height);
+
+	void encodeBlockBC1(const uint8_t* block, uint8_t* destination);
+	void encodeBlockBC3(const uint8_t* block, uint8_t* destination);
+	void encodeBlockBC5(const uint8_t* block, uint8_t* destination);
+	void encodeBlockBC7(const uint8_t* block, uint8_t* destination);
+
+	/* Compresses one image, rows of blocks are spread over the shared thread pool */
+	void compress(BlockFormat format, const uint8_t* rgba, uint32_t width, uint32_t height, uint8_t* destination);
+	/* 2x2 box filter to half resolution, the last row or column is repeated for odd sizes */
+	void downsample(const uint8_t* rgba, uint32_t width, uint32_t height, std::vector<uint8_t>& outRgba);
+	/* Downsamples down to 1x1 and compresses every level, levels are stored back to back in outData */
+	void compressMipChain(BlockFormat format, const uint8_t* rgba, uint32_t width, uint32_t height, std::vector<uint8_t>& outData, std::vector<MipLevel>& outLevels);
+
+}
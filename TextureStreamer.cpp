@@ -0,0 +1,337 @@
+#include "TextureStreamer.h"
+
+#include "FileUtils.h"
+#include "TextureCache.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+TextureStreamer::TextureStreamer(const GraphicsVulkan& gfx, vk::DeviceSize budget) :
+	mBudget(budget) {
+	mGfx = &gfx;
+	mWorker = std::thread([this]() { workerLoop(); });
+}
+
+TextureStreamer::~TextureStreamer() {
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mStop = true;
+	}
+	mJobsCondition.notify_all();
+	mWorker.join();
+}
+
+std::vector<TextureStreamer::Handle> TextureStreamer::AddMany(const std::vector<VulkanImage::Source>& sources) {
+	struct Request {
+		VulkanImage::Source source;
+		std::string key;
+		uint64_t contentKey = 0;
+		Request* loader = nullptr; //request that loads this content, nullptr if the content is already known
+		std::unique_ptr<Texture> texture;
+		Handle handle = INVALID_HANDLE;
+	};
+
+	//Adds are serialized, so a file is never loaded twice by concurrent callers
+	std::lock_guard<std::mutex> addLock(mAddMutex);
+
+	std::unordered_map<std::string, Request> requests;
+	std::vector<Request*> unknownPaths;
+	std::vector<std::string> keys(sources.size());
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		for (size_t i = 0; i < sources.size(); i++) {
+			if (sources[i].filename.empty()) continue;
+			//Every usage of a file is a texture of its own
+			keys[i] = TextureCache::NormalizePath(sources[i].filename) + "#" + std::to_string((int)sources[i].usage);
+
+			auto result = requests.emplace(keys[i], Request{});
+			Request& request = result.first->second;
+			if (!result.second) continue;
+			request.source = sources[i];
+			request.key = keys[i];
+			auto known = mHandles.find(keys[i]);
+			if (known != mHandles.end()) {
+				request.handle = known->second;
+			} else {
+				unknownPaths.push_back(&request);
+			}
+		}
+	}
+
+	//Copies of a file under other paths are found by content, like in the TextureCache
+	ThreadPool::Shared().ParallelFor((uint32_t)unknownPaths.size(), [&](uint32_t i) {
+		Request& request = *unknownPaths[i];
+		uint64_t hash = FileUtils::hashFile(request.source.filename);
+		if (hash != 0) request.contentKey = FileUtils::hashFNV1a(&request.source.usage, sizeof(request.source.usage), hash);
+	});
+
+	std::vector<Request*> missing;
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		std::unordered_map<uint64_t, Request*> loaders;
+		for (Request* request : unknownPaths) {
+			//Unreadable files have no content key, their load reports the error
+			if (request->contentKey == 0) {
+				request->loader = request;
+				missing.push_back(request);
+				continue;
+			}
+			auto known = mContentHandles.find(request->contentKey);
+			if (known != mContentHandles.end()) {
+				request->handle = known->second;
+				continue;
+			}
+			Request*& loader = loaders[request->contentKey];
+			if (!loader) {
+				loader = request;
+				missing.push_back(request);
+			}
+			request->loader = loader;
+		}
+	}
+
+	ThreadPool::Shared().ParallelFor((uint32_t)missing.size(), [&](uint32_t i) {
+		Request& request = *missing[i];
+		std::unique_ptr<Texture> texture = std::make_unique<Texture>();
+		try {
+			VulkanImage::LoadData(*mGfx, request.source.filename, texture->data, request.source.usage);
+			request.texture = std::move(texture);
+		} catch (const std::exception& e) {
+			std::cout << e.what() << std::endl;
+		}
+	});
+
+	//Image creation and upload recording stay on this thread, the batcher is not thread safe
+	{
+		UploadBatcher batcher(*mGfx, STAGING_SIZE);
+		for (Request* request : missing) {
+			if (!request->texture) continue;
+			Texture& texture = *request->texture;
+			uint32_t levelCount = (uint32_t)texture.data.levels.size();
+
+			texture.baseSize = std::max(texture.data.width, texture.data.height);
+			texture.streamed = !texture.data.generateMips && levelCount > 1;
+			texture.baseMip = 0;
+			if (texture.streamed) {
+				while (texture.baseMip + 1 < levelCount && (texture.baseSize >> texture.baseMip) > BASE_SIZE) texture.baseMip++;
+
+				texture.fullSize = getSize(texture, 0);
+				texture.residentSize = getSize(texture, texture.baseMip);
+				VulkanImage::Data range;
+				makeLevelRange(texture.data, texture.baseMip, range);
+				texture.image = std::make_shared<VulkanImage>(*mGfx, range, batcher);
+			} else {
+				//Only the base level is stored, the image keeps its whole chain
+				texture.fullSize = texture.data.GetSize();
+				texture.residentSize = texture.fullSize;
+				texture.image = std::make_shared<VulkanImage>(*mGfx, texture.data, batcher);
+			}
+			texture.residentMip = texture.baseMip;
+			texture.targetMip = texture.baseMip;
+			texture.requestedMip = texture.baseMip;
+		}
+		batcher.Flush();
+	}
+
+	std::lock_guard<std::mutex> lock(mMutex);
+	for (Request* request : missing) {
+		if (!request->texture) continue;
+		request->handle = (Handle)mTextures.size();
+		mResidentSize += request->texture->residentSize;
+		mProjectedSize += request->texture->residentSize;
+		mTextures.push_back(std::move(request->texture));
+		if (request->contentKey != 0) mContentHandles[request->contentKey] = request->handle;
+	}
+	//Every new path remembers its handle, also those that share the content of another one
+	for (Request* request : unknownPaths) {
+		if (request->loader) request->handle = request->loader->handle;
+		if (request->handle != INVALID_HANDLE) mHandles[request->key] = request->handle;
+	}
+
+	std::vector<Handle> handles(sources.size(), INVALID_HANDLE);
+	for (size_t i = 0; i < sources.size(); i++) {
+		if (!keys[i].empty()) handles[i] = requests[keys[i]].handle;
+	}
+	return handles;
+}
+
+void TextureStreamer::RequestMip(Handle handle, uint32_t mip) {
+	std::lock_guard<std::mutex> lock(mMutex);
+	Texture& texture = *mTextures[handle];
+	if (texture.lastUsedFrame != mFrame) {
+		texture.lastUsedFrame = mFrame;
+		texture.requestedMip = mip;
+	} else {
+		texture.requestedMip = std::min(texture.requestedMip, mip);
+	}
+}
+
+uint32_t TextureStreamer::ComputeMip(Handle handle, float screenSize) const {
+	std::lock_guard<std::mutex> lock(mMutex);
+	const Texture& texture = *mTextures[handle];
+	if (!(screenSize < (float)texture.baseSize)) return 0;
+
+	float mip = std::floor(std::log2((float)texture.baseSize / std::max(screenSize, 1.0f)));
+	return std::min((uint32_t)mip, texture.baseMip);
+}
+
+void TextureStreamer::Update() {
+	std::lock_guard<std::mutex> lock(mMutex);
+
+	for (FinishedJob& job : mFinished) {
+		Texture& texture = *mTextures[job.handle];
+		if (job.image) {
+			vk::DeviceSize size = getSize(texture, job.mip);
+			mResidentSize = mResidentSize - texture.residentSize + size;
+			texture.residentSize = size;
+			texture.residentMip = job.mip;
+			//Frames still recording with the old image hold their own reference
+			texture.image = std::move(job.image);
+		} else {
+			mProjectedSize = mProjectedSize - getSize(texture, job.mip) + texture.residentSize;
+		}
+		texture.targetMip = texture.residentMip;
+	}
+	mFinished.clear();
+
+	//A lowered budget is honoured even if nothing wants to grow
+	evict(0);
+
+	std::vector<Handle> upgrades;
+	for (Handle handle = 0; handle < (Handle)mTextures.size(); handle++) {
+		const Texture& texture = *mTextures[handle];
+		if (!texture.streamed || texture.targetMip != texture.residentMip) continue;
+		if (texture.lastUsedFrame == mFrame && texture.requestedMip < texture.residentMip) upgrades.push_back(handle);
+	}
+	//Textures furthest away from what they need go first
+	std::sort(upgrades.begin(), upgrades.end(), [this](Handle a, Handle b) {
+		const Texture& textureA = *mTextures[a];
+		const Texture& textureB = *mTextures[b];
+		return textureA.residentMip - textureA.requestedMip > textureB.residentMip - textureB.requestedMip;
+	});
+
+	vk::DeviceSize uploadSize = 0;
+	for (Handle handle : upgrades) {
+		const Texture& texture = *mTextures[handle];
+		//One level per step keeps single uploads small and spreads big textures over several frames
+		uint32_t mip = texture.residentMip - 1;
+		vk::DeviceSize size = getSize(texture, mip);
+		if (uploadSize > 0 && uploadSize + size > MAX_UPLOAD_PER_FRAME) break;
+		if (!evict(size - texture.residentSize)) break;
+
+		queueJob(handle, mip);
+		uploadSize += size;
+	}
+
+	mFrame++;
+}
+
+std::shared_ptr<VulkanImage> TextureStreamer::GetImage(Handle handle) const {
+	std::lock_guard<std::mutex> lock(mMutex);
+	return mTextures[handle]->image;
+}
+
+uint32_t TextureStreamer::GetResidentMip(Handle handle) const {
+	std::lock_guard<std::mutex> lock(mMutex);
+	return mTextures[handle]->residentMip;
+}
+
+void TextureStreamer::SetBudget(vk::DeviceSize budget) {
+	std::lock_guard<std::mutex> lock(mMutex);
+	mBudget = budget;
+}
+
+vk::DeviceSize TextureStreamer::GetBudget() const {
+	std::lock_guard<std::mutex> lock(mMutex);
+	return mBudget;
+}
+
+TextureStreamer::Stats TextureStreamer::GetStats() const {
+	std::lock_guard<std::mutex> lock(mMutex);
+	Stats stats{ (uint32_t)mTextures.size(), 0, 0, mResidentSize, 0 };
+	for (const std::unique_ptr<Texture>& texture : mTextures) {
+		if (texture->streamed) stats.streamed++;
+		if (texture->targetMip != texture->residentMip) stats.pendingJobs++;
+		stats.fullSize += texture->fullSize;
+	}
+	return stats;
+}
+
+void TextureStreamer::workerLoop() {
+	UploadBatcher batcher(*mGfx, STAGING_SIZE);
+
+	std::unique_lock<std::mutex> lock(mMutex);
+	while (true) {
+		mJobsCondition.wait(lock, [this]() { return mStop || !mJobs.empty(); });
+		if (mStop) break;
+
+		std::vector<Job> jobs(mJobs.begin(), mJobs.end());
+		mJobs.clear();
+		std::vector<const Texture*> textures;
+		for (const Job& job : jobs) textures.push_back(mTextures[job.handle].get());
+		lock.unlock();
+
+		//The mapped source of a texture never changes after it was added, it is read without the lock
+		std::vector<FinishedJob> finished;
+		for (size_t i = 0; i < jobs.size(); i++) {
+			FinishedJob result{ jobs[i].handle, jobs[i].mip, nullptr };
+			try {
+				VulkanImage::Data range;
+				makeLevelRange(textures[i]->data, jobs[i].mip, range);
+				result.image = std::make_shared<VulkanImage>(*mGfx, range, batcher);
+			} catch (const std::exception& e) {
+				std::cout << "Streaming texture " << jobs[i].handle << " failed: " << e.what() << std::endl;
+			}
+			finished.push_back(std::move(result));
+		}
+		//Swapped in by Update() only after the upload is complete
+		batcher.Flush();
+
+		lock.lock();
+		for (FinishedJob& job : finished) mFinished.push_back(std::move(job));
+	}
+}
+
+void TextureStreamer::queueJob(Handle handle, uint32_t mip) {
+	Texture& texture = *mTextures[handle];
+	mProjectedSize = mProjectedSize - texture.residentSize + getSize(texture, mip);
+	texture.targetMip = mip;
+	mJobs.push_back(Job{ handle, mip });
+	mJobsCondition.notify_one();
+}
+
+bool TextureStreamer::evict(vk::DeviceSize growth) {
+	while (mProjectedSize + growth > mBudget) {
+		//Least recently used texture that has mips above its base and was not drawn this frame
+		Handle victim = INVALID_HANDLE;
+		for (Handle handle = 0; handle < (Handle)mTextures.size(); handle++) {
+			const Texture& texture = *mTextures[handle];
+			if (!texture.streamed || texture.targetMip != texture.residentMip || texture.residentMip >= texture.baseMip) continue;
+			if (texture.lastUsedFrame == mFrame) continue;
+			if (victim == INVALID_HANDLE || texture.lastUsedFrame < mTextures[victim]->lastUsedFrame) victim = handle;
+		}
+		if (victim == INVALID_HANDLE) return false;
+
+		queueJob(victim, mTextures[victim]->baseMip);
+	}
+	return true;
+}
+
+vk::DeviceSize TextureStreamer::getSize(const Texture& texture, uint32_t firstMip) {
+	vk::DeviceSize size = 0;
+	for (size_t i = firstMip; i < texture.data.levels.size(); i++) size += texture.data.levels[i].size;
+	return size;
+}
+
+void TextureStreamer::makeLevelRange(const VulkanImage::Data& data, uint32_t firstMip, VulkanImage::Data& outData) {
+	outData.format = data.format;
+	outData.width = data.levels[firstMip].width;
+	outData.height = data.levels[firstMip].height;
+	outData.mipLevels = (uint32_t)data.levels.size() - firstMip;
+	outData.arrayLayers = data.arrayLayers;
+	outData.blockDim = data.blockDim;
+	outData.generateMips = false;
+	outData.levels.assign(data.levels.begin() + firstMip, data.levels.end());
+}
@@ -0,0 +1,123 @@
+#pragma once
+
+#include "GraphicsVulkan.h"
+#include "UploadBatcher.h"
+#include "VulkanImage.h"
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+/*
+	Keeps textures resident only down to the mip level the screen needs, within a VRAM budget.
+	Textures start with their coarse mips, the draw loop reports the finest level it wants every frame
+	and Update() upgrades one level at a time, evicting high mips of the least recently used textures when
+	the budget is exceeded. A residency change builds a new image from the mapped source and swaps it in
+	once its upload finished, the old image lives on as long as a frame still holds it.
+	Only textures with a stored mip chain (cooked or KTX2) are streamed, others stay fully resident.
+*/
+class TextureStreamer {
+public:
+	typedef uint32_t Handle;
+	static const Handle INVALID_HANDLE = ~0u;
+
+	struct Stats {
+		uint32_t textures;
+		uint32_t streamed;
+		uint32_t pendingJobs;
+		vk::DeviceSize residentSize;
+		vk::DeviceSize fullSize; //everything at mip 0
+	};
+
+public:
+	TextureStreamer(const GraphicsVulkan& gfx, vk::DeviceSize budget);
+	/* Waits for the upload thread */
+	~TextureStreamer();
+	TextureStreamer(const TextureStreamer&) = delete;
+	TextureStreamer& operator=(const TextureStreamer&) = delete;
+
+	/*
+		Thread safe and blocking. New files are decoded in parallel and their coarse mips go out in one upload.
+		Known sources return their existing handle, copies of a known file loaded with the same usage share it.
+		Empty names and files that fail to load give INVALID_HANDLE.
+	*/
+	std::vector<Handle> AddMany(const std::vector<VulkanImage::Source>& sources);
+
+	/* Render thread, the texture is drawn this frame and would like mip level mip (0 is the finest) */
+	void RequestMip(Handle handle, uint32_t mip);
+	/* Finest mip level that is still not magnified when the texture covers screenSize pixels */
+	uint32_t ComputeMip(Handle handle, float screenSize) const;
+	/* Render thread, once per frame. Swaps in finished uploads and queues upgrades and evictions */
+	void Update();
+
+	/* nullptr until the first upload finished */
+	std::shared_ptr<VulkanImage> GetImage(Handle handle) const;
+	uint32_t GetResidentMip(Handle handle) const;
+
+	void SetBudget(vk::DeviceSize budget);
+	vk::DeviceSize GetBudget() const;
+	Stats GetStats() const;
+
+private:
+	//Coarse mips every texture keeps, they are tiny and loaded with the texture
+	const uint32_t BASE_SIZE = 64;
+	//Bounds the upload work queued per frame, so streaming can not stall the GPU
+	const vk::DeviceSize MAX_UPLOAD_PER_FRAME = 8 * 1024 * 1024;
+	const vk::DeviceSize STAGING_SIZE = 16 * 1024 * 1024;
+
+	struct Texture {
+		VulkanImage::Data data; //kept mapped for later upgrades
+		bool streamed;
+		uint32_t baseMip;       //coarsest level the texture is ever reduced to
+		uint32_t residentMip;   //finest level on the GPU
+		uint32_t targetMip;     //level of the job in flight, residentMip if there is none
+		uint32_t requestedMip;  //finest level asked for this frame
+		uint64_t lastUsedFrame = 0;
+		vk::DeviceSize residentSize = 0;
+		vk::DeviceSize fullSize = 0;
+		uint32_t baseSize = 0;  //texels on the longer side of level 0
+		std::shared_ptr<VulkanImage> image;
+	};
+	struct Job {
+		Handle handle;
+		uint32_t mip;
+	};
+	struct FinishedJob {
+		Handle handle;
+		uint32_t mip;
+		std::shared_ptr<VulkanImage> image;
+	};
+
+	void workerLoop();
+	/* Queues a residency change and books its size change, mMutex has to be held */
+	void queueJob(Handle handle, uint32_t mip);
+	/* Frees room for growth by sending unused textures back to their base mip, mMutex has to be held */
+	bool evict(vk::DeviceSize growth);
+	static vk::DeviceSize getSize(const Texture& texture, uint32_t firstMip);
+	/* Data referring to the levels from firstMip on, without owning them */
+	static void makeLevelRange(const VulkanImage::Data& data, uint32_t firstMip, VulkanImage::Data& outData);
+
+private:
+	const GraphicsVulkan* mGfx;
+
+	std::mutex mAddMutex;
+	mutable std::mutex mMutex;
+	std::vector<std::unique_ptr<Texture>> mTextures;
+	std::unordered_map<std::string, Handle> mHandles;     //by normalized path and usage
+	std::unordered_map<uint64_t, Handle> mContentHandles; //by content hash and usage
+	vk::DeviceSize mBudget;
+	vk::DeviceSize mResidentSize = 0;
+	vk::DeviceSize mProjectedSize = 0; //resident size once all queued jobs finished
+	uint64_t mFrame = 1;
+
+	std::thread mWorker;
+	std::condition_variable mJobsCondition;
+	std::deque<Job> mJobs;
+	std::vector<FinishedJob> mFinished;
+	bool mStop = false;
+};
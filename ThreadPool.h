@@ -0,0 +1,113 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+//Fixed set of worker threads consuming a shared job queue
+class ThreadPool {
+public:
+	ThreadPool(uint32_t threadCount = defaultThreadCount()) {
+		for (uint32_t i = 0; i < threadCount; i++) {
+			mWorkers.emplace_back([this]() { workerLoop(); });
+		}
+	}
+	~ThreadPool() {
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			mStopping = true;
+		}
+		mJobAvailable.notify_all();
+		for (std::thread& worker : mWorkers) worker.join();
+	}
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	static ThreadPool& Shared() {
+		static ThreadPool pool;
+		return pool;
+	}
+
+	uint32_t GetThreadCount() const {
+		return (uint32_t)mWorkers.size();
+	}
+
+	void Submit(std::function<void()> job) {
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			mJobs.push(std::move(job));
+		}
+		mJobAvailable.notify_one();
+	}
+
+	/*
+		Runs func(i) for every i in [0, count) and returns once all calls finished.
+		The calling thread works on the range too, so this is safe to call from inside a job.
+	*/
+	void ParallelFor(uint32_t count, const std::function<void(uint32_t)>& func) {
+		if (count == 0) return;
+
+		struct State {
+			std::function<void(uint32_t)> func;
+			uint32_t count;
+			std::atomic<uint32_t> next{ 0 };
+			std::atomic<uint32_t> done{ 0 };
+			std::mutex mutex;
+			std::condition_variable finished;
+		};
+		std::shared_ptr<State> state = std::make_shared<State>();
+		state->func = func;
+		state->count = count;
+
+		auto work = [state]() {
+			uint32_t i;
+			while ((i = state->next.fetch_add(1)) < state->count) {
+				state->func(i);
+				if (state->done.fetch_add(1) + 1 == state->count) {
+					std::lock_guard<std::mutex> lock(state->mutex);
+					state->finished.notify_all();
+				}
+			}
+		};
+
+		uint32_t helpers = std::min(GetThreadCount(), count - 1);
+		for (uint32_t i = 0; i < helpers; i++) Submit(work);
+		work();
+
+		std::unique_lock<std::mutex> lock(state->mutex);
+		state->finished.wait(lock, [&state]() { return state->done.load() == state->count; });
+	}
+
+private:
+	static uint32_t defaultThreadCount() {
+		uint32_t hardwareThreads = std::thread::hardware_concurrency();
+		return hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+	}
+
+	void workerLoop() {
+		while (true) {
+			std::function<void()> job;
+			{
+				std::unique_lock<std::mutex> lock(mMutex);
+				mJobAvailable.wait(lock, [this]() { return mStopping || !mJobs.empty(); });
+				if (mStopping && mJobs.empty()) return;
+				job = std::move(mJobs.front());
+				mJobs.pop();
+			}
+			job();
+		}
+	}
+
+private:
+	std::vector<std::thread> mWorkers;
+	std::queue<std::function<void()>> mJobs;
+	std::mutex mMutex;
+	std::condition_variable mJobAvailable;
+	bool mStopping = false;
+};
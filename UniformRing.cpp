@@ -0,0 +1,22 @@
+#include "UniformRing.h"
+
+#include <stdexcept>
+
+UniformRing::UniformRing(const GraphicsVulkan& gfx, vk::DeviceSize frameSize) {
+	mAlignment = gfx.mPhysicalDevice.getProperties().limits.minUniformBufferOffsetAlignment;
+	for (uint32_t i = 0; i < gfx.MAX_FRAMES_IN_FLIGHT; i++) {
+		mFrames.push_back(std::make_unique<LinearPool>(gfx.GetAllocator(), frameSize, vk::BufferUsageFlagBits::eUniformBuffer,
+			vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent, MemoryAllocator::Category::Uniform));
+	}
+}
+
+void UniformRing::BeginFrame(uint32_t frameIndex) {
+	mFrameIndex = frameIndex;
+	mFrames[frameIndex]->Reset();
+}
+
+UniformRing::Slice UniformRing::Allocate(vk::DeviceSize size) {
+	LinearPool::Range range;
+	if (!mFrames[mFrameIndex]->Allocate(size, mAlignment, range)) throw std::runtime_error("Uniform ring is full, " + std::to_string(size) + " bytes requested");
+	return Slice{ range.buffer, (uint32_t)range.offset, range.mapped };
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "GraphicsVulkan.h"
+
+#include <memory>
+#include <vector>
+
+/*
+	Persistently mapped uniform memory with one region per frame in flight. Callers bump-allocate a slice,
+	write it through the mapped pointer and bind it with its offset as the dynamic offset of an
+	eUniformBufferDynamic descriptor. A region is only reused after the fence of its frame was waited,
+	so the GPU never reads data a later frame is writing. Render thread only.
+*/
+class UniformRing {
+public:
+	struct Slice {
+		vk::Buffer buffer;
+		uint32_t offset; //dynamic offset for bindDescriptorSets
+		uint8_t* data;
+	};
+
+public:
+	UniformRing(const GraphicsVulkan& gfx, vk::DeviceSize frameSize);
+	UniformRing(const UniformRing&) = delete;
+	UniformRing& operator=(const UniformRing&) = delete;
+
+	/* Starts reusing the region of frameIndex, the GPU has to be done with that frame */
+	void BeginFrame(uint32_t frameIndex);
+	/* Slice of the current frame, aligned to minUniformBufferOffsetAlignment, valid until its region is reused */
+	Slice Allocate(vk::DeviceSize size);
+
+	/* Region of a frame, what the dynamic descriptors used in that frame point to */
+	vk::Buffer GetBuffer(uint32_t frameIndex) const {
+		return mFrames[frameIndex]->GetBuffer();
+	}
+	vk::DeviceSize GetUsed() const {
+		return mFrames[mFrameIndex]->GetUsed();
+	}
+
+private:
+	std::vector<std::unique_ptr<LinearPool>> mFrames;
+	vk::DeviceSize mAlignment;
+	uint32_t mFrameIndex = 0;
+};
@@ -0,0 +1,150 @@
+#include "UploadBatcher.h"
+
+#include <algorithm>
+#include <numeric>
+
+UploadBatcher::UploadBatcher(const GraphicsVulkan& gfx, vk::DeviceSize stagingSize) :
+	mStagingSize(stagingSize) {
+	mGfx = &gfx;
+
+	vk::CommandPoolCreateInfo poolCreateInfo{ vk::CommandPoolCreateFlagBits::eTransient | vk::CommandPoolCreateFlagBits::eResetCommandBuffer, gfx.mQueueFamilyIndices.graphicsFamily.value() };
+	mCommandPool = gfx.mDevice.createCommandPool(poolCreateInfo);
+}
+
+UploadBatcher::~UploadBatcher() {
+	Flush();
+
+	//Frees the command buffers along with it
+	mGfx->mDevice.destroyCommandPool(mCommandPool);
+}
+
+void UploadBatcher::CopyToBuffer(const void* data, vk::DeviceSize size, vk::Buffer dst, vk::DeviceSize dstOffset) {
+	const uint8_t* src = (const uint8_t*)data;
+	while (size > 0) {
+		vk::DeviceSize chunkSize = std::min(size, mStagingSize);
+		vk::DeviceSize stagingOffset = reserve(chunkSize, STAGING_ALIGNMENT);
+		memcpy(mStaging.data + stagingOffset, src, chunkSize);
+
+		mCommandBuffer.copyBuffer(mStaging.buffer, dst, vk::BufferCopy{ stagingOffset, dstOffset, chunkSize });
+
+		src += chunkSize;
+		dstOffset += chunkSize;
+		size -= chunkSize;
+	}
+}
+
+void UploadBatcher::CopyToImage(const void* data, vk::DeviceSize size, vk::Image dst, uint32_t width, uint32_t height, uint32_t mipLevels) {
+	beginRecording();
+	VulkanUtils::transitionImageLayout(mCommandBuffer, dst, vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal, 0, mipLevels);
+	copyImageLevel(ImageLevel{ data, size, width, height }, dst, 0, 1, 0);
+
+	if (mipLevels > 1) {
+		VulkanUtils::generateMipmaps(mCommandBuffer, dst, width, height, mipLevels);
+	} else {
+		VulkanUtils::transitionImageLayout(mCommandBuffer, dst, vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eShaderReadOnlyOptimal);
+	}
+}
+
+void UploadBatcher::CopyToImageLevels(const ImageLevel* levels, uint32_t levelCount, vk::Image dst, uint32_t blockDim, uint32_t layerCount) {
+	beginRecording();
+	VulkanUtils::transitionImageLayout(mCommandBuffer, dst, vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal, 0, levelCount, layerCount);
+	for (uint32_t i = 0; i < levelCount; i++) {
+		//Layers of a level are packed one after the other
+		ImageLevel layerLevel = levels[i];
+		layerLevel.size /= levels[i].layers;
+		for (uint32_t layer = 0; layer < levels[i].layers; layer++) {
+			layerLevel.data = (const uint8_t*)levels[i].data + layerLevel.size * layer;
+			copyImageLevel(layerLevel, dst, i, blockDim, layer);
+		}
+	}
+	VulkanUtils::transitionImageLayout(mCommandBuffer, dst, vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eShaderReadOnlyOptimal, 0, levelCount, layerCount);
+}
+
+void UploadBatcher::Flush() {
+	if (mRecording) submit();
+	while (!mInFlight.empty()) waitOldest();
+}
+
+void UploadBatcher::copyImageLevel(const ImageLevel& level, vk::Image dst, uint32_t mipLevel, uint32_t blockDim, uint32_t layer) {
+	const uint8_t* src = (const uint8_t*)level.data;
+	uint32_t blockRows = (level.height + blockDim - 1) / blockDim;
+	vk::DeviceSize rowSize = level.size / blockRows;
+	//bufferOffset has to be a multiple of the texel block size, which is 6 or 12 bytes for some formats
+	vk::DeviceSize texelBlockSize = rowSize / ((level.width + blockDim - 1) / blockDim);
+	vk::DeviceSize alignment = std::lcm(STAGING_ALIGNMENT, texelBlockSize);
+	//A row larger than the staging size goes alone, reserve gets a big enough staging buffer for it
+	uint32_t maxRowsPerCopy = (uint32_t)std::max<vk::DeviceSize>(1, mStagingSize / rowSize);
+
+	uint32_t row = 0;
+	while (row < blockRows) {
+		uint32_t rows = std::min(blockRows - row, maxRowsPerCopy);
+		vk::DeviceSize chunkSize = rowSize * rows;
+		vk::DeviceSize stagingOffset = reserve(chunkSize, alignment);
+		memcpy(mStaging.data + stagingOffset, src + rowSize * row, chunkSize);
+
+		//Copies of block compressed images may end at the image edge instead of a block edge
+		uint32_t y = row * blockDim;
+		uint32_t height = std::min(rows * blockDim, level.height - y);
+		vk::BufferImageCopy copy{ stagingOffset, 0, 0, vk::ImageSubresourceLayers{ vk::ImageAspectFlagBits::eColor, mipLevel, layer, 1 },
+			vk::Offset3D{ 0, (int32_t)y, 0 }, vk::Extent3D{ level.width, height, 1 } };
+		mCommandBuffer.copyBufferToImage(mStaging.buffer, dst, vk::ImageLayout::eTransferDstOptimal, copy);
+
+		row += rows;
+	}
+}
+
+vk::DeviceSize UploadBatcher::reserve(vk::DeviceSize size, vk::DeviceSize alignment) {
+	beginRecording(size);
+	vk::DeviceSize offset = (mStagingHead + alignment - 1) / alignment * alignment;
+	if (offset + size > mStaging.size) {
+		//Staging buffer is full, it goes to the GPU while recording continues in another one
+		submit();
+		beginRecording(size);
+		offset = 0;
+	}
+	mStagingHead = offset + size;
+	return offset;
+}
+
+void UploadBatcher::beginRecording(vk::DeviceSize minStagingSize) {
+	if (mRecording) return;
+	if (mFreeCommandBuffers.empty()) {
+		mCommandBuffer = mGfx->mDevice.allocateCommandBuffers({ mCommandPool, vk::CommandBufferLevel::ePrimary, 1 })[0];
+	} else {
+		mCommandBuffer = mFreeCommandBuffers.back();
+		mFreeCommandBuffers.pop_back();
+	}
+	mCommandBuffer.begin({ vk::CommandBufferUsageFlagBits::eOneTimeSubmit });
+	//A single image row can be larger than the staging size, it can not be split any further
+	mStaging = mGfx->GetStagingPool().Acquire(std::max(mStagingSize, minStagingSize));
+	mStagingHead = 0;
+	mRecording = true;
+}
+
+void UploadBatcher::submit() {
+	//Make the buffer copies visible to geometry fetch of later submissions, images got their own barrier already
+	vk::MemoryBarrier barrier{ vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eVertexAttributeRead | vk::AccessFlagBits::eIndexRead };
+	mCommandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eVertexInput, {}, barrier, {}, {});
+	mCommandBuffer.end();
+	vk::SubmitInfo submitInfo(0, nullptr, nullptr, 1, &mCommandBuffer, 0, nullptr);
+	{
+		std::lock_guard<std::mutex> lock(mGfx->mQueueMutex);
+		mGfx->mGfxQueue.submit(submitInfo, mStaging.fence);
+	}
+	mStaging.submitted = true;
+
+	mInFlight.push_back(Submission{ mCommandBuffer, mStaging });
+	mStaging = StagingPool::Buffer{};
+	mRecording = false;
+	if (mInFlight.size() > MAX_SUBMISSIONS_IN_FLIGHT) waitOldest();
+}
+
+void UploadBatcher::waitOldest() {
+	Submission& oldest = mInFlight.front();
+	mGfx->mDevice.waitForFences(oldest.staging.fence, VK_TRUE, UINT64_MAX);
+	oldest.commandBuffer.reset({});
+	mFreeCommandBuffers.push_back(oldest.commandBuffer);
+	//The pool resets the signaled fence before it hands the buffer out again
+	mGfx->GetStagingPool().Release(oldest.staging);
+	mInFlight.pop_front();
+}
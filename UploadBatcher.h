@@ -0,0 +1,76 @@
+#pragma once
+
+#include "GraphicsVulkan.h"
+#include "StagingPool.h"
+
+#include <deque>
+
+/*
+	Collects buffer and image uploads into one command buffer backed by a staging buffer from the shared pool.
+	Everything recorded is submitted on Flush(). A full staging buffer is submitted right away and recording
+	goes on in another one, the oldest submission is only waited for when too many are in flight.
+	Uploads larger than the staging size are split into several copies, an image row that does not fit on its own
+	gets a staging buffer of its size.
+	A batcher belongs to one thread, but several threads can each use their own.
+*/
+class UploadBatcher {
+public:
+	/* One prepared mip level, rows are counted in blocks for block compressed formats. Array layers follow each other */
+	struct ImageLevel {
+		const void* data;
+		vk::DeviceSize size;
+		uint32_t width;
+		uint32_t height;
+		uint32_t layers = 1;
+	};
+
+public:
+	/* stagingSize is the size of each staging buffer taken from the pool */
+	UploadBatcher(const GraphicsVulkan& gfx, vk::DeviceSize stagingSize);
+	~UploadBatcher();
+	UploadBatcher(const UploadBatcher&) = delete;
+	UploadBatcher& operator=(const UploadBatcher&) = delete;
+
+	void CopyToBuffer(const void* data, vk::DeviceSize size, vk::Buffer dst, vk::DeviceSize dstOffset);
+	/*
+		Tightly packed data for level 0, image ends up in eShaderReadOnlyOptimal.
+		Further mip levels are generated by blits, which needs eTransferSrc usage and a linear filterable format.
+	*/
+	void CopyToImage(const void* data, vk::DeviceSize size, vk::Image dst, uint32_t width, uint32_t height, uint32_t mipLevels = 1);
+	/* Uploads all levels as they are, blockDim is the texel width and height of a block, 1 for uncompressed formats */
+	void CopyToImageLevels(const ImageLevel* levels, uint32_t levelCount, vk::Image dst, uint32_t blockDim, uint32_t layerCount = 1);
+	/* Submits all recorded copies and waits for them, the staging buffers go back to the pool */
+	void Flush();
+
+private:
+	//Image copies additionally need offsets that are a multiple of their texel block size
+	const vk::DeviceSize STAGING_ALIGNMENT = 16;
+	//Full staging buffers that may be on the GPU at once before recording waits for the oldest
+	const size_t MAX_SUBMISSIONS_IN_FLIGHT = 2;
+
+	struct Submission {
+		vk::CommandBuffer commandBuffer;
+		StagingPool::Buffer staging; //its fence tracks the submission
+	};
+
+	/* Room for size bytes in the current staging buffer, a new one is started if they do not fit. alignment may be any multiple of 4 */
+	vk::DeviceSize reserve(vk::DeviceSize size, vk::DeviceSize alignment);
+	void copyImageLevel(const ImageLevel& level, vk::Image dst, uint32_t mipLevel, uint32_t blockDim, uint32_t layer);
+	/* minStagingSize is only needed for copies larger than the usual staging size */
+	void beginRecording(vk::DeviceSize minStagingSize = 0);
+	void submit();
+	void waitOldest();
+
+private:
+	const GraphicsVulkan* mGfx;
+
+	vk::CommandPool mCommandPool;
+	vk::CommandBuffer mCommandBuffer;
+	std::vector<vk::CommandBuffer> mFreeCommandBuffers;
+	std::deque<Submission> mInFlight;
+	bool mRecording = false;
+
+	StagingPool::Buffer mStaging; //only held while recording
+	vk::DeviceSize mStagingSize;
+	vk::DeviceSize mStagingHead = 0;
+};
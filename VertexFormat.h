@@ -0,0 +1,99 @@
+#pragma once
+
+#include "vulkan/vulkan.hpp"
+
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
+
+#include <vector>
+
+//Set to 0 to upload full precision float vertices instead of the quantized layout
+#ifndef NOU_COMPACT_VERTICES
+#define NOU_COMPACT_VERTICES 1
+#endif
+
+namespace VertexFormat {
+
+	/*
+		Per mesh push constant to reconstruct object space positions: pos * posScale + posOffset.
+		Matches the push constant block in shader.vert.
+	*/
+	struct Decode {
+		glm::vec4 posScale = glm::vec4(1.0f);
+		glm::vec4 posOffset = glm::vec4(0.0f);
+	};
+
+	//32 bit floats, 20 bytes
+	struct FullVertex {
+		glm::vec3 pos;
+		glm::vec2 uv;
+
+		static Decode computeDecode(glm::vec3 boundsMin, glm::vec3 boundsMax) {
+			return Decode{};
+		}
+		static FullVertex encode(glm::vec3 pos, glm::vec2 uv, const Decode& decode) {
+			return FullVertex{ pos, uv };
+		}
+
+		static vk::VertexInputBindingDescription getBindingDesc() {
+			vk::VertexInputBindingDescription desc(0, sizeof(FullVertex), vk::VertexInputRate::eVertex);
+			return desc;
+		}
+		static std::vector<vk::VertexInputAttributeDescription> getAttrDesc() {
+			std::vector<vk::VertexInputAttributeDescription> desc = {
+				vk::VertexInputAttributeDescription(0, 0, vk::Format::eR32G32B32Sfloat, offsetof(FullVertex, pos)),
+				vk::VertexInputAttributeDescription(1, 0, vk::Format::eR32G32Sfloat, offsetof(FullVertex, uv))
+			};
+			return desc;
+		}
+	};
+
+	//16 bit positions normalized to the mesh bounds and half float uvs, 12 bytes
+	struct CompactVertex {
+		uint16_t pos[4];
+		uint16_t uv[2];
+
+		static Decode computeDecode(glm::vec3 boundsMin, glm::vec3 boundsMax) {
+			glm::vec3 extent = boundsMax - boundsMin;
+			//Flat meshes would divide by zero while encoding
+			extent = glm::max(extent, glm::vec3(1e-6f));
+
+			Decode decode;
+			decode.posScale = glm::vec4(extent, 1.0f);
+			decode.posOffset = glm::vec4(boundsMin, 0.0f);
+			return decode;
+		}
+		static CompactVertex encode(glm::vec3 pos, glm::vec2 uv, const Decode& decode) {
+			glm::vec3 normalized = glm::clamp((pos - glm::vec3(decode.posOffset)) / glm::vec3(decode.posScale), 0.0f, 1.0f);
+
+			CompactVertex vertex;
+			vertex.pos[0] = (uint16_t)(normalized.x * 65535.0f + 0.5f);
+			vertex.pos[1] = (uint16_t)(normalized.y * 65535.0f + 0.5f);
+			vertex.pos[2] = (uint16_t)(normalized.z * 65535.0f + 0.5f);
+			vertex.pos[3] = 0;
+			vertex.uv[0] = glm::packHalf1x16(uv.x);
+			vertex.uv[1] = glm::packHalf1x16(uv.y);
+			return vertex;
+		}
+
+		static vk::VertexInputBindingDescription getBindingDesc() {
+			vk::VertexInputBindingDescription desc(0, sizeof(CompactVertex), vk::VertexInputRate::eVertex);
+			return desc;
+		}
+		static std::vector<vk::VertexInputAttributeDescription> getAttrDesc() {
+			std::vector<vk::VertexInputAttributeDescription> desc = {
+				vk::VertexInputAttributeDescription(0, 0, vk::Format::eR16G16B16A16Unorm, offsetof(CompactVertex, pos)),
+				vk::VertexInputAttributeDescription(1, 0, vk::Format::eR16G16Sfloat, offsetof(CompactVertex, uv))
+			};
+			return desc;
+		}
+	};
+
+#if NOU_COMPACT_VERTICES
+	using GpuVertex = CompactVertex;
+#else
+	using GpuVertex = FullVertex;
+#endif
+
+}
@@ -1,55 +1,205 @@
 #include "VulkanImage.h"
 
+#include "PixelConvert.h"
+
 #define STB_IMAGE_IMPLEMENTATION
 #include "STBI/stb_image.h"
 
+uint64_t VulkanImage::Data::GetSize() const {
+	uint64_t size = 0;
+	for (const UploadBatcher::ImageLevel& level : levels) size += level.size;
+	return size;
+}
+
 VulkanImage::VulkanImage(const GraphicsVulkan& gfx, std::string filename) {
-	loadImageData(filename);
-	createImage(gfx.mDevice, gfx.mPhysicalDevice, vk::Format::eR8G8B8A8Unorm);
-	fillImageWithData(gfx.mDevice, gfx.mPhysicalDevice, gfx.mCommandPool, gfx.mGfxQueue);
-	createImageView(gfx.mDevice, vk::Format::eR8G8B8A8Unorm);
+	Data data;
+	LoadData(gfx, filename, data);
+	UploadBatcher batcher(gfx, data.GetSize());
+	init(gfx, data, batcher);
+}
+
+VulkanImage::VulkanImage(const GraphicsVulkan& gfx, std::string filename, UploadBatcher& batcher) {
+	Data data;
+	LoadData(gfx, filename, data);
+	init(gfx, data, batcher);
+}
+
+VulkanImage::VulkanImage(const GraphicsVulkan& gfx, Data& data, UploadBatcher& batcher) {
+	init(gfx, data, batcher);
 }
 
 VulkanImage::~VulkanImage() {
-	//destroy Image View
-	//destroy Image
-	//free mImageMemory
+	//Frames in flight may still sample it, streamed textures are swapped and dropped while rendering
+	vk::Device device = mGfx->mDevice;
+	MemoryAllocator* allocator = &mGfx->GetAllocator();
+	vk::ImageView imageView = mImageView;
+	vk::Image image = mImage;
+	MemoryAllocator::Allocation imageMemory = mImageMemory;
+	mGfx->GetDeletionQueue().Push([device, allocator, imageView, image, imageMemory]() mutable {
+		device.destroyImageView(imageView);
+		allocator->DestroyImage(image, imageMemory);
+	});
+}
+
+void VulkanImage::init(const GraphicsVulkan& gfx, Data& data, UploadBatcher& batcher) {
+	mGfx = &gfx;
+	mMipLevels = data.mipLevels;
+	mArrayLayers = data.arrayLayers;
+	createImage(data);
+	fillImageWithData(batcher, data);
+	createImageView(gfx.mDevice, data.format);
+}
+
+void VulkanImage::createImage(const Data& data) {
+	//Blitted mips read from the level above
+	vk::ImageUsageFlags usage = vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled;
+	if (data.generateMips) usage |= vk::ImageUsageFlagBits::eTransferSrc;
+
+	mGfx->GetAllocator().CreateImage(data.format, data.width, data.height, data.mipLevels, usage, MemoryAllocator::Category::Texture, mImage, mImageMemory, data.arrayLayers);
 }
 
-void VulkanImage::createImage(vk::Device device, vk::PhysicalDevice physDevice, vk::Format format) {
+uint32_t VulkanImage::chooseMipLevels(vk::PhysicalDevice physDevice, vk::Format format, uint32_t width, uint32_t height) {
+	vk::FormatFeatureFlags required = vk::FormatFeatureFlagBits::eBlitSrc | vk::FormatFeatureFlagBits::eBlitDst | vk::FormatFeatureFlagBits::eSampledImageFilterLinear;
+	vk::FormatProperties props = physDevice.getFormatProperties(format);
+	if ((props.optimalTilingFeatures & required) != required) return 1;
 
-	VulkanUtils::createImage(device, physDevice, format, mImgWidth, mImgHeight,
-		vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled, mImage, mImageMemory);
+	return VulkanUtils::getMipLevelCount(width, height);
 }
 
-void VulkanImage::loadImageData(std::string filename) {
+void VulkanImage::LoadData(const GraphicsVulkan& gfx, const std::string& filename, Data& outData, Usage usage) {
+	outData.levels.clear();
+
+	if (KtxTexture::IsKtxFile(filename)) {
+		loadKtxData(gfx, filename, outData);
+		return;
+	}
+
+	if (gfx.mTextureCompressionBC) {
+		CookedTexture::Content content = CookedTexture::Content::Color;
+		const char* extension = COOKED_EXTENSION;
+		if (usage == Usage::PremultipliedColor) {
+			content = CookedTexture::Content::PremultipliedColor;
+			extension = PREMULTIPLIED_COOKED_EXTENSION;
+		} else if (usage == Usage::NormalMap) {
+			content = CookedTexture::Content::NormalMap;
+			extension = NORMAL_MAP_COOKED_EXTENSION;
+		}
+		outData.cooked = std::make_unique<CookedTexture>(filename, filename + extension, content);
+		outData.format = getBlockFormat(outData.cooked->GetFormat());
+		outData.width = outData.cooked->GetWidth();
+		outData.height = outData.cooked->GetHeight();
+		outData.mipLevels = (uint32_t)outData.cooked->GetLevels().size();
+		outData.generateMips = false;
+		outData.blockDim = 4;
+		for (const CookedTexture::Level& level : outData.cooked->GetLevels()) {
+			outData.levels.push_back(UploadBatcher::ImageLevel{ level.data, level.size, level.width, level.height });
+		}
+		return;
+	}
+
+	loadDecodedData(gfx, filename, outData, usage);
+}
+
+void VulkanImage::loadDecodedData(const GraphicsVulkan& gfx, const std::string& filename, Data& outData, Usage usage) {
 	int imgWidth;
 	int imgHeight;
 	int imgChannels;
+	if (!stbi_info(filename.c_str(), &imgWidth, &imgHeight, &imgChannels)) throw std::runtime_error("Failed to load image " + filename);
+
+	//RGB files are decoded as they are and expanded with SIMD, stb would expand them one component at a time
+	int loadChannels = imgChannels == STBI_rgb ? STBI_rgb : STBI_rgb_alpha;
+	outData.pixels.reset(stbi_load(filename.c_str(), &imgWidth, &imgHeight, &imgChannels, loadChannels));
+	if (!outData.pixels) throw std::runtime_error("Failed to load image " + filename);
 
-	mImgData = stbi_load(filename.c_str(), &imgWidth, &imgHeight, &imgChannels, STBI_rgb_alpha);
-	mImgByteSize = imgWidth * imgHeight * 4;
+	size_t pixelCount = (size_t)imgWidth * imgHeight;
+	uint8_t* rgba = outData.pixels.get();
+	if (loadChannels == STBI_rgb) {
+		outData.converted.resize(pixelCount * 4);
+		PixelConvert::expandRGBToRGBA(outData.pixels.get(), outData.converted.data(), pixelCount);
+		outData.pixels.reset();
+		rgba = outData.converted.data();
+	}
 
-	mImgWidth = imgWidth;
-	mImgHeight = imgHeight;
+	//Before the mips are blitted, so transparent texels do not bleed their color into the coarser levels
+	if (usage == Usage::PremultipliedColor) PixelConvert::premultiplyAlphaSrgb(rgba, pixelCount);
+
+	outData.format = vk::Format::eR8G8B8A8Unorm;
+	uint32_t bytesPerPixel = 4;
+	if (usage == Usage::NormalMap) {
+		//Packed in place, every pixel is written behind the ones still to be read
+		PixelConvert::packRGBAToRG(rgba, rgba, pixelCount);
+		outData.format = vk::Format::eR8G8Unorm;
+		bytesPerPixel = 2;
+	}
+
+	outData.width = imgWidth;
+	outData.height = imgHeight;
+	outData.mipLevels = chooseMipLevels(gfx.mPhysicalDevice, outData.format, outData.width, outData.height);
+	outData.generateMips = outData.mipLevels > 1;
+	outData.levels.push_back(UploadBatcher::ImageLevel{ rgba, (vk::DeviceSize)pixelCount * bytesPerPixel, outData.width, outData.height });
 }
 
-void VulkanImage::fillImageWithData(vk::Device device, vk::PhysicalDevice physDevice, vk::CommandPool cmdPool, vk::Queue queue) {
-	vk::Buffer tmpBuffer;
-	vk::DeviceMemory tmpMemory;
-	VulkanUtils::createBuffer(device, physDevice, mImgByteSize, vk::BufferUsageFlagBits::eTransferSrc, vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent, tmpBuffer, tmpMemory);
+void VulkanImage::loadKtxData(const GraphicsVulkan& gfx, const std::string& filename, Data& outData) {
+	outData.ktx = std::make_unique<KtxTexture>(filename);
+	const KtxTexture& ktx = *outData.ktx;
+
+	//The payload is uploaded as it is, so the device has to sample the stored format directly
+	vk::Format format = (vk::Format)ktx.GetVkFormat();
+	const char* missingFeature = nullptr;
+	if (format >= vk::Format::eBc1RgbUnormBlock && format <= vk::Format::eBc7SrgbBlock && !gfx.mTextureCompressionBC) {
+		missingFeature = "textureCompressionBC";
+	} else if (format >= vk::Format::eEtc2R8G8B8UnormBlock && format <= vk::Format::eEacR11G11SnormBlock && !gfx.mTextureCompressionETC2) {
+		missingFeature = "textureCompressionETC2";
+	} else if (format >= vk::Format::eAstc4x4UnormBlock && format <= vk::Format::eAstc12x12SrgbBlock && !gfx.mTextureCompressionASTC) {
+		missingFeature = "textureCompressionASTC_LDR";
+	}
+	if (missingFeature) {
+		throw std::runtime_error(filename + " is stored as " + vk::to_string(format) + ", which needs the " + missingFeature + " feature this device does not have");
+	}
+	vk::FormatProperties props = gfx.mPhysicalDevice.getFormatProperties(format);
+	if (!(props.optimalTilingFeatures & vk::FormatFeatureFlagBits::eSampledImage)) {
+		throw std::runtime_error("Format " + vk::to_string(format) + " of " + filename + " can not be sampled on this device");
+	}
 
-	void* data = device.mapMemory(tmpMemory, 0, mImgByteSize);
-	memcpy(data, mImgData, mImgByteSize);
-	device.unmapMemory(tmpMemory);
-	free(mImgData);
+	outData.format = format;
+	outData.width = ktx.GetWidth();
+	outData.height = ktx.GetHeight();
+	outData.arrayLayers = ktx.GetLayerCount();
+	outData.blockDim = ktx.GetBlockDim();
+	outData.mipLevels = (uint32_t)ktx.GetLevels().size();
+	outData.generateMips = false;
+	//Blitting is only done for single layer, uncompressed images, others keep their base level
+	if (ktx.WantsGeneratedMips() && outData.blockDim == 1 && outData.arrayLayers == 1) {
+		outData.mipLevels = chooseMipLevels(gfx.mPhysicalDevice, format, outData.width, outData.height);
+		outData.generateMips = outData.mipLevels > 1;
+	}
+	for (const KtxTexture::Level& level : ktx.GetLevels()) {
+		outData.levels.push_back(UploadBatcher::ImageLevel{ level.data, level.size, level.width, level.height, outData.arrayLayers });
+	}
+}
+
+void VulkanImage::fillImageWithData(UploadBatcher& batcher, Data& data) {
+	if (data.generateMips) {
+		const UploadBatcher::ImageLevel& base = data.levels[0];
+		batcher.CopyToImage(base.data, base.size, mImage, base.width, base.height, data.mipLevels);
+	} else {
+		batcher.CopyToImageLevels(data.levels.data(), (uint32_t)data.levels.size(), mImage, data.blockDim, data.arrayLayers);
+	}
 
-	vk::CommandBuffer cmdBuffer = VulkanUtils::startSingleUserCmdBuffer(device, cmdPool);
-	VulkanUtils::transitionImageLayout(cmdBuffer, device, cmdPool, queue, mImage, vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal);
-	VulkanUtils::copyBufferToImage(cmdBuffer, device, cmdPool, queue, tmpBuffer, mImage, mImgWidth, mImgHeight);
-	VulkanUtils::transitionImageLayout(cmdBuffer, device, cmdPool, queue, mImage, vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eShaderReadOnlyOptimal);
-	VulkanUtils::endSingleUseCmdBuffer(cmdBuffer, queue);
+	//Batcher copies into its staging memory right away, so the source data can go
+	data.levels.clear();
+	data.cooked.reset();
+	data.ktx.reset();
+	data.pixels.reset();
+	data.converted.clear();
+}
 
-	device.destroyBuffer(tmpBuffer);
-	device.freeMemory(tmpMemory);
+vk::Format VulkanImage::getBlockFormat(TextureCompressor::BlockFormat format) {
+	switch (format) {
+	case TextureCompressor::BlockFormat::BC1: return vk::Format::eBc1RgbUnormBlock;
+	case TextureCompressor::BlockFormat::BC3: return vk::Format::eBc3UnormBlock;
+	case TextureCompressor::BlockFormat::BC5: return vk::Format::eBc5UnormBlock;
+	case TextureCompressor::BlockFormat::BC7: return vk::Format::eBc7UnormBlock;
+	}
+	throw std::runtime_error("Unknown block format");
 }
\ No newline at end of file
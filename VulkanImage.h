@@ -1,39 +1,100 @@
 #pragma once
 
 #include "GraphicsVulkan.h"
+#include "UploadBatcher.h"
+#include "CookedTexture.h"
+#include "KtxTexture.h"
 
 #include "STBI/stb_image.h"
 
+#include <memory>
+
 class VulkanImage {
+public:
+	/* What the texels are used for, decides the conversion applied on load */
+	enum class Usage {
+		Color,
+		PremultipliedColor, //sRGB color multiplied by alpha before the mips are built
+		NormalMap           //only red and green are kept as R8G8, z is rebuilt in the shader
+	};
+
+	/* An image file and its usage, the same file loaded with two usages gives two images */
+	struct Source {
+		std::string filename;
+		Usage usage = Usage::Color;
+	};
+
+	/* CPU side of an image, filled by LoadData and consumed by the constructor */
+	struct Data {
+		vk::Format format;
+		uint32_t width;
+		uint32_t height;
+		uint32_t mipLevels;
+		uint32_t arrayLayers = 1;
+		uint32_t blockDim = 1;
+		bool generateMips; //true if only level 0 is present and the rest is blitted on the GPU
+		std::vector<UploadBatcher::ImageLevel> levels;
+
+		std::unique_ptr<CookedTexture> cooked;
+		std::unique_ptr<KtxTexture> ktx;
+		std::unique_ptr<stbi_uc, void(*)(void*)> pixels{ nullptr, stbi_image_free };
+		std::vector<uint8_t> converted; //decoded pixels after a format conversion
+
+		uint64_t GetSize() const;
+	};
 
 public:
 	VulkanImage(const GraphicsVulkan& gfx, std::string filename);
+	/* Upload is only recorded, the image is ready after batcher.Flush() */
+	VulkanImage(const GraphicsVulkan& gfx, std::string filename, UploadBatcher& batcher);
+	/* Creates the image from data prepared by LoadData, the data is released afterwards */
+	VulkanImage(const GraphicsVulkan& gfx, Data& data, UploadBatcher& batcher);
 	VulkanImage(const VulkanImage&) = delete;
 	VulkanImage& operator=(const VulkanImage&) = delete;
+	/* Frees the image right away, the owner has to make sure no frame in flight still uses it */
 	~VulkanImage();
 
-	vk::ImageView GetImageView() {
+	vk::ImageView GetImageView() const {
 		return mImageView;
 	}
 
+	/*
+		Decodes, or maps the cooked version of, an image file. Does not touch the device,
+		so it is safe to call from several worker threads at once.
+		Block compressed if the device supports it, decoded RGBA8 otherwise. Normal maps become BC5, or R8G8 when decoded.
+		.ktx2 files are mapped and uploaded in their own format without any decoding, so usage does not affect them.
+	*/
+	static void LoadData(const GraphicsVulkan& gfx, const std::string& filename, Data& outData, Usage usage = Usage::Color);
+
 private:
-	void createImage(vk::Device device, vk::PhysicalDevice physDevice, vk::Format format);
-	void loadImageData(std::string filename);
-	void fillImageWithData(vk::Device device, vk::PhysicalDevice physDevice, vk::CommandPool cmdPool, vk::Queue queue);
+	//Cooked textures are cached next to their source, one file per usage
+	static constexpr const char* COOKED_EXTENSION = ".ntex";
+	static constexpr const char* PREMULTIPLIED_COOKED_EXTENSION = ".pm.ntex";
+	static constexpr const char* NORMAL_MAP_COOKED_EXTENSION = ".nm.ntex";
+
+	void init(const GraphicsVulkan& gfx, Data& data, UploadBatcher& batcher);
+	void createImage(const Data& data);
+	/* Full chain if the format can be blitted with a linear filter, otherwise only the base level */
+	static uint32_t chooseMipLevels(vk::PhysicalDevice physDevice, vk::Format format, uint32_t width, uint32_t height);
+	static void loadDecodedData(const GraphicsVulkan& gfx, const std::string& filename, Data& outData, Usage usage);
+	static void loadKtxData(const GraphicsVulkan& gfx, const std::string& filename, Data& outData);
+	void fillImageWithData(UploadBatcher& batcher, Data& data);
 	void createImageView(vk::Device device, vk::Format format) {
-		vk::ImageViewCreateInfo createInfo{ {}, mImage, vk::ImageViewType::e2D, format, {},
-			vk::ImageSubresourceRange{ vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1} };
+		//Arrays need a sampler2DArray in the shader
+		vk::ImageViewType viewType = mArrayLayers > 1 ? vk::ImageViewType::e2DArray : vk::ImageViewType::e2D;
+		vk::ImageViewCreateInfo createInfo{ {}, mImage, viewType, format, {},
+			vk::ImageSubresourceRange{ vk::ImageAspectFlagBits::eColor, 0, mMipLevels, 0, mArrayLayers} };
 		mImageView = device.createImageView(createInfo);
 
 	}
+	static vk::Format getBlockFormat(TextureCompressor::BlockFormat format);
 private:
 	vk::ImageView mImageView;
 	vk::Image mImage;
-	vk::DeviceMemory mImageMemory;
+	MemoryAllocator::Allocation mImageMemory;
+	const GraphicsVulkan* mGfx;
 
-	uint32_t mImgWidth;
-	uint32_t mImgHeight;
-	stbi_uc* mImgData;
-	uint32_t mImgByteSize;
+	uint32_t mMipLevels;
+	uint32_t mArrayLayers;
 
 };
\ No newline at end of file
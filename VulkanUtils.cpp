@@ -68,31 +68,6 @@ namespace VulkanUtils {
 		return avaiblePresentModes[0];
 	}
 
-	void createBuffer(const vk::Device& device, const vk::PhysicalDevice& physDevice, uint64_t size, vk::BufferUsageFlags usage, vk::MemoryPropertyFlags memoryProperties,
-		vk::Buffer& buffer, vk::DeviceMemory& memory) {
-
-		vk::BufferCreateInfo bufferCreateInfo{ {}, size, usage, vk::SharingMode::eExclusive };
-		buffer = device.createBuffer(bufferCreateInfo);
-
-		vk::MemoryRequirements requirements = device.getBufferMemoryRequirements(buffer);
-		vk::MemoryAllocateInfo allocateInfo{ requirements.size, findMemoryType(physDevice, requirements.memoryTypeBits, memoryProperties) };
-		memory = device.allocateMemory(allocateInfo);
-		device.bindBufferMemory(buffer, memory, 0);
-	}
-
-	uint32_t findMemoryType(const vk::PhysicalDevice& physDevice, uint32_t typeFilter, vk::MemoryPropertyFlags properties) {
-		vk::PhysicalDeviceMemoryProperties memProps = physDevice.getMemoryProperties();
-
-		for (uint32_t i = 0; i < memProps.memoryTypeCount; i++) {
-			if (typeFilter & (1 << i) && (memProps.memoryTypes[i].propertyFlags & properties) == properties) {
-				return i;
-			}
-		}
-
-		return 0;
-	}
-
-
 	void copyBuffer(const vk::Device& device, const vk::CommandPool& cmdPool, const vk::Queue& queue, vk::Buffer srcBuffer, vk::DeviceSize srcOffset, vk::Buffer dstBuffer, vk::DeviceSize dstOffset, uint32_t size) {
 		vk::CommandBufferAllocateInfo allocateInfo{ cmdPool, vk::CommandBufferLevel::ePrimary, 1 };
 		vk::CommandBuffer tmpBuffer = device.allocateCommandBuffers(allocateInfo)[0];
@@ -106,6 +81,7 @@ namespace VulkanUtils {
 		vk::SubmitInfo submitInfo(0, nullptr, nullptr, 1, &tmpBuffer, 0, nullptr);
 		queue.submit(submitInfo, nullptr);
 		queue.waitIdle();
+		device.freeCommandBuffers(cmdPool, tmpBuffer);
 	}
 
 
@@ -120,14 +96,10 @@ namespace VulkanUtils {
 	}
 	*/
 	
-	void createImage(vk::Device device, vk::PhysicalDevice physDevice, vk::Format format, uint32_t width, uint32_t height, vk::ImageUsageFlags usage, vk::Image& outImage, vk::DeviceMemory& outMemory) {
-		vk::ImageCreateInfo info{ {}, vk::ImageType::e2D, format, {width, height, 1}, 1, 1, vk::SampleCountFlagBits::e1, vk::ImageTiling::eOptimal, usage, vk::SharingMode::eExclusive, 0, nullptr, vk::ImageLayout::eUndefined };
-		outImage = device.createImage(info);
-		vk::MemoryRequirements req = device.getImageMemoryRequirements(outImage);
-		uint32_t imageSize = req.size;
-		vk::MemoryAllocateInfo allocInfo{ imageSize, findMemoryType(physDevice, req.memoryTypeBits, vk::MemoryPropertyFlagBits::eDeviceLocal) };
-		outMemory = device.allocateMemory(allocInfo);
-		device.bindImageMemory(outImage, outMemory, 0);
+	uint32_t getMipLevelCount(uint32_t width, uint32_t height) {
+		uint32_t levels = 1;
+		for (uint32_t size = std::max(width, height); size > 1; size >>= 1) levels++;
+		return levels;
 	}
 
 	vk::CommandBuffer startSingleUserCmdBuffer(vk::Device device, vk::CommandPool cmdPool) {
@@ -138,15 +110,16 @@ namespace VulkanUtils {
 		return tmpBuffer;
 	}
 
-	void endSingleUseCmdBuffer(vk::CommandBuffer tmpBuffer, vk::Queue queue) {
+	void endSingleUseCmdBuffer(vk::Device device, vk::CommandPool cmdPool, vk::CommandBuffer tmpBuffer, vk::Queue queue) {
 		tmpBuffer.end();
 
 		vk::SubmitInfo submitInfo(0, nullptr, nullptr, 1, &tmpBuffer, 0, nullptr);
 		queue.submit(submitInfo, nullptr);
 		queue.waitIdle();
+		device.freeCommandBuffers(cmdPool, tmpBuffer);
 	}
 
-	void transitionImageLayout(vk::CommandBuffer cmdBuffer, vk::Device device, vk::CommandPool cmdPool, vk::Queue queue, vk::Image image, vk::ImageLayout oldLayout, vk::ImageLayout newLayout) {
+	void transitionImageLayout(vk::CommandBuffer cmdBuffer, vk::Image image, vk::ImageLayout oldLayout, vk::ImageLayout newLayout, uint32_t baseMipLevel, uint32_t mipLevels, uint32_t layerCount) {
 		vk::AccessFlags srcAccess;
 		vk::AccessFlags dstAccess;
 		vk::PipelineStageFlags srcStage;
@@ -162,14 +135,47 @@ namespace VulkanUtils {
 			dstAccess = vk::AccessFlagBits::eShaderRead;
 			srcStage = vk::PipelineStageFlagBits::eTransfer;
 			dstStage = vk::PipelineStageFlagBits::eFragmentShader;
+		} else if (oldLayout == vk::ImageLayout::eTransferDstOptimal && newLayout == vk::ImageLayout::eTransferSrcOptimal) {
+			srcAccess = vk::AccessFlagBits::eTransferWrite;
+			dstAccess = vk::AccessFlagBits::eTransferRead;
+			srcStage = vk::PipelineStageFlagBits::eTransfer;
+			dstStage = vk::PipelineStageFlagBits::eTransfer;
+		} else if (oldLayout == vk::ImageLayout::eTransferSrcOptimal && newLayout == vk::ImageLayout::eShaderReadOnlyOptimal) {
+			srcAccess = vk::AccessFlagBits::eTransferRead;
+			dstAccess = vk::AccessFlagBits::eShaderRead;
+			srcStage = vk::PipelineStageFlagBits::eTransfer;
+			dstStage = vk::PipelineStageFlagBits::eFragmentShader;
+		} else {
+			throw std::runtime_error("Unsupported image layout transition");
 		}
 
-		vk::ImageSubresourceRange range{ vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1 };
+		vk::ImageSubresourceRange range{ vk::ImageAspectFlagBits::eColor, baseMipLevel, mipLevels, 0, layerCount };
 		vk::ImageMemoryBarrier barrier{ srcAccess, dstAccess, oldLayout, newLayout, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, image, range };
 		cmdBuffer.pipelineBarrier(srcStage, dstStage, {}, {}, {}, barrier);
 	}
 
-	void copyBufferToImage(vk::CommandBuffer cmdBuffer, vk::Device device, vk::CommandPool cmdPool, vk::Queue queue, vk::Buffer src, vk::Image dst, uint32_t width, uint32_t height) {
+	void generateMipmaps(vk::CommandBuffer cmdBuffer, vk::Image image, uint32_t width, uint32_t height, uint32_t mipLevels) {
+		int32_t srcWidth = (int32_t)width;
+		int32_t srcHeight = (int32_t)height;
+		for (uint32_t level = 1; level < mipLevels; level++) {
+			int32_t dstWidth = std::max(srcWidth / 2, 1);
+			int32_t dstHeight = std::max(srcHeight / 2, 1);
+
+			//Each level is written by the previous blit or copy and read by the next one
+			transitionImageLayout(cmdBuffer, image, vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eTransferSrcOptimal, level - 1);
+			vk::ImageBlit blit{
+				vk::ImageSubresourceLayers{ vk::ImageAspectFlagBits::eColor, level - 1, 0, 1 }, { vk::Offset3D{ 0, 0, 0 }, vk::Offset3D{ srcWidth, srcHeight, 1 } },
+				vk::ImageSubresourceLayers{ vk::ImageAspectFlagBits::eColor, level, 0, 1 }, { vk::Offset3D{ 0, 0, 0 }, vk::Offset3D{ dstWidth, dstHeight, 1 } } };
+			cmdBuffer.blitImage(image, vk::ImageLayout::eTransferSrcOptimal, image, vk::ImageLayout::eTransferDstOptimal, blit, vk::Filter::eLinear);
+			transitionImageLayout(cmdBuffer, image, vk::ImageLayout::eTransferSrcOptimal, vk::ImageLayout::eShaderReadOnlyOptimal, level - 1);
+
+			srcWidth = dstWidth;
+			srcHeight = dstHeight;
+		}
+		transitionImageLayout(cmdBuffer, image, vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eShaderReadOnlyOptimal, mipLevels - 1);
+	}
+
+	void copyBufferToImage(vk::CommandBuffer cmdBuffer, vk::Buffer src, vk::Image dst, uint32_t width, uint32_t height) {
 
 		vk::BufferImageCopy copy;
 		copy.bufferOffset = 0;
@@ -203,9 +209,9 @@ namespace VulkanUtils {
 		return format == vk::Format::eD32SfloatS8Uint || format == vk::Format::eD24UnormS8Uint;
 	}
 
-	vk::ImageView createImageView(vk::Device device, vk::Image image, vk::Format format, vk::ImageAspectFlags aspectFlag) {
+	vk::ImageView createImageView(vk::Device device, vk::Image image, vk::Format format, vk::ImageAspectFlags aspectFlag, uint32_t mipLevels) {
 		vk::ImageViewCreateInfo createInfo{ {}, image, vk::ImageViewType::e2D, format, {},
-			vk::ImageSubresourceRange{ aspectFlag, 0, 1, 0, 1} };
+			vk::ImageSubresourceRange{ aspectFlag, 0, mipLevels, 0, 1} };
 		return device.createImageView(createInfo);
 	}
 
@@ -21,18 +21,18 @@ namespace VulkanUtils {
 	vk::SurfaceFormatKHR chooseFormat(std::vector<vk::SurfaceFormatKHR> avaibleFormats, vk::Format targetFormat, vk::ColorSpaceKHR targetSpace);
 	vk::Extent2D chooseExtent(vk::Extent2D target, vk::Extent2D currentExtent, vk::Extent2D minExtent, vk::Extent2D maxExtent);
 	vk::PresentModeKHR choosePresentMode(std::vector<vk::PresentModeKHR> avaiblePresentModes, vk::PresentModeKHR target);
-	void createBuffer(const vk::Device& device, const vk::PhysicalDevice& physDevice, uint64_t size, vk::BufferUsageFlags usage, vk::MemoryPropertyFlags memoryProperties, vk::Buffer& buffer, vk::DeviceMemory& memory);
-	uint32_t findMemoryType(const vk::PhysicalDevice& physDevice, uint32_t typeFilter, vk::MemoryPropertyFlags properties);
 	void copyBuffer(const vk::Device& device, const vk::CommandPool& cmdPool, const vk::Queue& queue, vk::Buffer srcBuffer, vk::DeviceSize srcOffset, vk::Buffer dstBuffer, vk::DeviceSize dstOffset, uint32_t size);
 	void copyBuffer(const vk::Device& device, const vk::CommandPool& cmdPool, const vk::Queue& queue, vk::Buffer srcBuffer, vk::Buffer dstBuffer, uint32_t size);
 	//void copyBuffer(const vk::Device& device, const vk::CommandBuffer& buffer, vk::Buffer srcBuffer, vk::Buffer dstBuffer, uint32_t size, uint32_t offset);
-	void createImage(vk::Device device, vk::PhysicalDevice physDevice, vk::Format format, uint32_t width, uint32_t height, vk::ImageUsageFlags usage, vk::Image& outImage, vk::DeviceMemory& outMemory);
+	uint32_t getMipLevelCount(uint32_t width, uint32_t height);
 	vk::CommandBuffer startSingleUserCmdBuffer(vk::Device device, vk::CommandPool cmdPool);
-	void endSingleUseCmdBuffer(vk::CommandBuffer tmpBuffer, vk::Queue queue);
-	void transitionImageLayout(vk::CommandBuffer cmdBuffer, vk::Device device, vk::CommandPool cmdPool, vk::Queue queue, vk::Image image, vk::ImageLayout oldLayout, vk::ImageLayout newLayout);
-	void copyBufferToImage(vk::CommandBuffer cmdBuffer, vk::Device device, vk::CommandPool cmdPool, vk::Queue queue, vk::Buffer src, vk::Image dst, uint32_t width, uint32_t height);
+	void endSingleUseCmdBuffer(vk::Device device, vk::CommandPool cmdPool, vk::CommandBuffer tmpBuffer, vk::Queue queue);
+	void transitionImageLayout(vk::CommandBuffer cmdBuffer, vk::Image image, vk::ImageLayout oldLayout, vk::ImageLayout newLayout, uint32_t baseMipLevel = 0, uint32_t mipLevels = 1, uint32_t layerCount = 1);
+	//Expects level 0 filled and all levels in eTransferDstOptimal, leaves all levels in eShaderReadOnlyOptimal
+	void generateMipmaps(vk::CommandBuffer cmdBuffer, vk::Image image, uint32_t width, uint32_t height, uint32_t mipLevels);
+	void copyBufferToImage(vk::CommandBuffer cmdBuffer, vk::Buffer src, vk::Image dst, uint32_t width, uint32_t height);
 	vk::Format findSupportedFormat(vk::PhysicalDevice physDevice, const std::vector<vk::Format> condidates, vk::ImageTiling tiling, vk::FormatFeatureFlags features);
 	bool hasStencilComponent(vk::Format format);
-	vk::ImageView createImageView(vk::Device device, vk::Image image, vk::Format format, vk::ImageAspectFlags aspectFlag);
+	vk::ImageView createImageView(vk::Device device, vk::Image image, vk::Format format, vk::ImageAspectFlags aspectFlag, uint32_t mipLevels = 1);
 
 }
\ No newline at end of file
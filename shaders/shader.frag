@@ -1,13 +1,19 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
+#extension GL_EXT_nonuniform_qualifier : require
 
-layout(binding = 1) uniform sampler2D texSampler;
+//Texture table of all materials, the draw picks its entry through the push constant
+layout(binding = 1) uniform sampler2D textures[];
 
-layout(location = 0) in vec3 fragColor;
-layout(location = 1) in vec2 uv;
+//Follows VertexFormat::Decode of the vertex stage
+layout(push_constant) uniform DrawConstants{
+	layout(offset = 32) uint textureIndex;
+} draw;
+
+layout(location = 0) in vec2 uv;
 
 layout(location = 0) out vec4 outColor;
 
 void main(){
-	outColor = texture(texSampler, uv);
+	outColor = texture(textures[draw.textureIndex], uv);
 }
\ No newline at end of file
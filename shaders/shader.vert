@@ -7,17 +7,21 @@ layout(binding = 0) uniform UniformBufferObject{
 	mat4 proj; 
 } ubo;
 
+//VertexFormat::Decode, positions may be quantized to the mesh bounds
+layout(push_constant) uniform VertexDecode{
+	vec4 posScale;
+	vec4 posOffset;
+} decode;
+
 layout(location = 0) in vec3 pos;
-layout(location = 1) in vec3 col;
-layout(location = 2) in vec2 texcoord;
+layout(location = 1) in vec2 texcoord;
 
-layout(location = 0) out vec3 fragColor;
-layout(location = 1) out vec2 uv;
+layout(location = 0) out vec2 uv;
 
 void main(){
 	mat4 mvp = ubo.proj * ubo.view * ubo.model;
-	gl_Position = mvp * vec4(pos, 1.0);
+	vec3 objectPos = pos * decode.posScale.xyz + decode.posOffset.xyz;
+	gl_Position = mvp * vec4(objectPos, 1.0);
 	//gl_Position = vec4(pos, 0.0, 1.0);
-	fragColor = col;
 	uv = texcoord;
 }
\ No newline at end of file